@@ -3,65 +3,337 @@
 #ifndef __ARRAYLIST_H
 #define __ARRAYLIST_H
 
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include "IndexOutOfBound.h"
 #include "ElementNotExist.h"
 
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * Equality comparison of one vector register worth of elements.
+ * match() returns a byte-granular mask: sizeof(T) bits per matching element.
+ * Only the arithmetic types the target can compare lane-wise are specialized;
+ * everything else reports VECTORIZED == false and is scanned by a scalar loop.
+ */
+template <class T, bool INTEGRAL = std::is_integral<T>::value,
+		bool FLOATING = std::is_floating_point<T>::value, int BYTES = sizeof(T)>
+struct ArrayListScanKernel {
+	static const bool VECTORIZED = false;
+};
+
+#if defined(__AVX2__)
+
+#define ARRAYLIST_SCAN_KERNEL(INTEGRAL, FLOATING, BYTES, SPLAT, MATCH) \
+	template <class T> \
+	struct ArrayListScanKernel<T, INTEGRAL, FLOATING, BYTES> { \
+		static const bool VECTORIZED = true; \
+		static const int WIDTH = 32 / BYTES; \
+		typedef __m256i Vec; \
+		static Vec splat(const T &e) { return SPLAT; } \
+		static int match(const T *p, Vec v) { \
+			Vec x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); \
+			return _mm256_movemask_epi8(MATCH); \
+		} \
+	};
+
+ARRAYLIST_SCAN_KERNEL(true, false, 1, _mm256_set1_epi8((char)e), _mm256_cmpeq_epi8(x, v))
+ARRAYLIST_SCAN_KERNEL(true, false, 2, _mm256_set1_epi16((short)e), _mm256_cmpeq_epi16(x, v))
+ARRAYLIST_SCAN_KERNEL(true, false, 4, _mm256_set1_epi32((int)e), _mm256_cmpeq_epi32(x, v))
+ARRAYLIST_SCAN_KERNEL(true, false, 8, _mm256_set1_epi64x((long long)e), _mm256_cmpeq_epi64(x, v))
+ARRAYLIST_SCAN_KERNEL(false, true, 4, _mm256_castps_si256(_mm256_set1_ps((float)e)),
+		_mm256_castps_si256(_mm256_cmp_ps(_mm256_castsi256_ps(x), _mm256_castsi256_ps(v), _CMP_EQ_OQ)))
+ARRAYLIST_SCAN_KERNEL(false, true, 8, _mm256_castpd_si256(_mm256_set1_pd((double)e)),
+		_mm256_castpd_si256(_mm256_cmp_pd(_mm256_castsi256_pd(x), _mm256_castsi256_pd(v), _CMP_EQ_OQ)))
+
+#undef ARRAYLIST_SCAN_KERNEL
+
+#elif defined(__SSE2__)
+
+#define ARRAYLIST_SCAN_KERNEL(INTEGRAL, FLOATING, BYTES, SPLAT, MATCH) \
+	template <class T> \
+	struct ArrayListScanKernel<T, INTEGRAL, FLOATING, BYTES> { \
+		static const bool VECTORIZED = true; \
+		static const int WIDTH = 16 / BYTES; \
+		typedef __m128i Vec; \
+		static Vec splat(const T &e) { return SPLAT; } \
+		static int match(const T *p, Vec v) { \
+			Vec x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); \
+			return _mm_movemask_epi8(MATCH); \
+		} \
+	};
+
+ARRAYLIST_SCAN_KERNEL(true, false, 1, _mm_set1_epi8((char)e), _mm_cmpeq_epi8(x, v))
+ARRAYLIST_SCAN_KERNEL(true, false, 2, _mm_set1_epi16((short)e), _mm_cmpeq_epi16(x, v))
+ARRAYLIST_SCAN_KERNEL(true, false, 4, _mm_set1_epi32((int)e), _mm_cmpeq_epi32(x, v))
+#if defined(__SSE4_1__)
+ARRAYLIST_SCAN_KERNEL(true, false, 8, _mm_set1_epi64x((long long)e), _mm_cmpeq_epi64(x, v))
+#endif
+ARRAYLIST_SCAN_KERNEL(false, true, 4, _mm_castps_si128(_mm_set1_ps((float)e)),
+		_mm_castps_si128(_mm_cmpeq_ps(_mm_castsi128_ps(x), _mm_castsi128_ps(v))))
+ARRAYLIST_SCAN_KERNEL(false, true, 8, _mm_castpd_si128(_mm_set1_pd((double)e)),
+		_mm_castpd_si128(_mm_cmpeq_pd(_mm_castsi128_pd(x), _mm_castsi128_pd(v))))
+
+#undef ARRAYLIST_SCAN_KERNEL
+
+#endif
+
+template <class T, bool VECTORIZED = ArrayListScanKernel<T>::VECTORIZED>
+struct ArrayListScan {
+	static int indexOf(const T *a, int n, const T &e) {
+		for (int i = 0; i < n; ++i)
+			if (a[i] == e)
+				return i;
+		return -1;
+	}
+
+	static int lastIndexOf(const T *a, int n, const T &e) {
+		for (int i = n - 1; i >= 0; --i)
+			if (a[i] == e)
+				return i;
+		return -1;
+	}
+};
+
+template <class T>
+struct ArrayListScan<T, true> {
+	typedef ArrayListScanKernel<T> Kernel;
+
+	static int indexOf(const T *a, int n, const T &e) {
+		typename Kernel::Vec v = Kernel::splat(e);
+		int i = 0;
+		for (; i + Kernel::WIDTH <= n; i += Kernel::WIDTH) {
+			int m = Kernel::match(a + i, v);
+			if (m)
+				return i + __builtin_ctz(m) / (int)sizeof(T);
+		}
+		for (; i < n; ++i)
+			if (a[i] == e)
+				return i;
+		return -1;
+	}
+
+	static int lastIndexOf(const T *a, int n, const T &e) {
+		typename Kernel::Vec v = Kernel::splat(e);
+		int i = n;
+		for (; i >= Kernel::WIDTH; ) {
+			i -= Kernel::WIDTH;
+			int m = Kernel::match(a + i, v);
+			if (m)
+				return i + (31 - __builtin_clz(m)) / (int)sizeof(T);
+		}
+		for (--i; i >= 0; --i)
+			if (a[i] == e)
+				return i;
+		return -1;
+	}
+};
+
 template <class T>
 class ArrayList {
 private:
 
-	typedef T* Tp;
+	static const int MIN_SHRINK_CAPACITY = 16;
 
-	Tp* base;
+	T* base; // elements live inline in [base, base + _size)
 	int _size;
 	int capacity;
+	double growthFactor;
+	bool autoShrink;
+	int reserved; // capacity asked for by reserve(); auto-shrinking stops there
+
+	static T* allocate(int n) {
+		return n > 0 ? static_cast<T*>(::operator new(sizeof(T) * n)) : NULL;
+	}
+
+	static void deallocate(T* p) {
+		::operator delete(p);
+	}
+
+	static void destroy(T* first, T* last) {
+		if (!std::is_trivially_destructible<T>::value)
+			for (; first != last; ++first)
+				first->~T();
+	}
 
-	void cloneTo(Tp* &otherBase, int &otherSize, int &otherCapacity) const {
-		otherBase = new Tp[capacity];
-		otherSize = _size;
+	// move n elements from src into raw memory dst, leaving src raw
+	static void relocate(T* src, int n, T* dst) {
+		if (n <= 0) return;
+		if (std::is_trivially_copyable<T>::value) {
+			std::memcpy(static_cast<void*>(dst), static_cast<const void*>(src), sizeof(T) * n);
+			return;
+		}
+		for (int i = 0; i < n; ++i) {
+			new (dst + i) T(std::move(src[i]));
+			src[i].~T();
+		}
+	}
+
+	// shift [from, _size) n slots right, leaving [from, from + n) raw; capacity must allow it
+	void openGap(int from, int n = 1) {
+		if (std::is_trivially_copyable<T>::value) {
+			std::memmove(static_cast<void*>(base + from + n), static_cast<const void*>(base + from), sizeof(T) * (_size - from));
+			return;
+		}
+		for (int i = _size - 1; i >= from; --i) {
+			new (base + i + n) T(std::move(base[i]));
+			base[i].~T();
+		}
+	}
+
+	// shift [from + n, _size) n slots left over the already destroyed [from, from + n)
+	void closeGap(int from, int n = 1) {
+		if (std::is_trivially_copyable<T>::value) {
+			std::memmove(static_cast<void*>(base + from), static_cast<const void*>(base + from + n), sizeof(T) * (_size - from - n));
+			return;
+		}
+		for (int i = from + n; i < _size; ++i) {
+			new (base + i - n) T(std::move(base[i]));
+			base[i].~T();
+		}
+	}
+
+	void reallocate(int cap) {
+		T* newArray = allocate(cap);
+		relocate(base, _size, newArray);
+		if (base) deallocate(base);
+		base = newArray;
+		capacity = cap;
+	}
+
+	void cloneTo(T* &otherBase, int &otherSize, int &otherCapacity) const {
+		otherBase = allocate(capacity);
 		otherCapacity = capacity;
-		for (int i = 0; i < _size; ++i)
-			otherBase[i] = new T(*base[i]);
-		for (int i = _size; i < capacity; ++i)
-			otherBase[i] = NULL;
+		otherSize = 0;
+		try {
+			for (; otherSize < _size; ++otherSize)
+				new (otherBase + otherSize) T(base[otherSize]);
+		}
+		catch (...) {
+			destroy(otherBase, otherBase + otherSize);
+			deallocate(otherBase);
+			otherBase = NULL;
+			otherSize = otherCapacity = 0;
+			throw;
+		}
+	}
+
+	int grownCapacity(int cap) const {
+		double grown = capacity * growthFactor;
+		if (grown > 2147483647.0) grown = 2147483647.0;
+		return std::max(std::max((int)grown, capacity + 1), cap);
 	}
 
 	void ensureCapacity(int cap) {
-		if (cap > capacity) {
-			capacity = std::max(capacity << 1, cap);
-			Tp* newArray = new Tp[capacity];
-			for (int i = 0; i < _size; ++i)
-				newArray[i] = base[i];
-			for (int i = _size; i < capacity; ++i)
-				newArray[i] = NULL;
-			if (base) delete[] base;
-			base = newArray;
-		}
+		if (cap > capacity)
+			reallocate(grownCapacity(cap));
 	}
 
-	void trimToSize(int cap) {
-		if (cap <= capacity / 4) {
-			capacity = cap;
-			if (_size > capacity) {
-				for (int i = capacity; i < _size; ++i) {
-					if (base[i]) {
-						delete base[i];
-						base[i] = NULL;
-					}
+	// shrink only once the list is a quarter full, and then only to twice its size,
+	// so that an add/remove sequence around the boundary cannot reallocate repeatedly
+	void shrinkIfSparse() {
+		int floor = std::max(MIN_SHRINK_CAPACITY, reserved);
+		if (autoShrink && capacity > floor && _size <= capacity / 4)
+			reallocate(std::max(_size << 1, floor));
+	}
+
+	void copySettings(const ArrayList<T>& x) {
+		growthFactor = x.growthFactor;
+		autoShrink = x.autoShrink;
+		reserved = x.reserved;
+	}
+
+	// runs fn(0) .. fn(threads - 1) on their own threads; rethrows the first failure once all are done
+	template <class F>
+	static void runWorkers(int threads, F fn) {
+		std::vector<std::exception_ptr> errors(threads);
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads; ++t)
+			workers.push_back(std::thread([&, t]() {
+				try {
+					fn(t);
 				}
-				_size = capacity;
-			}
-			Tp *newArray = new Tp[capacity];
-			for (int i = 0; i < _size; ++i) newArray[i] = base[i];
-			for (int i = _size; i < capacity; ++i) newArray[i] = NULL; 
+				catch (...) {
+					errors[t] = std::current_exception();
+				}
+			}));
+		for (size_t t = 0; t < workers.size(); ++t)
+			workers[t].join();
+		for (int t = 0; t < threads; ++t)
+			if (errors[t])
+				std::rethrow_exception(errors[t]);
+	}
 
-			delete[] base;
-			base = newArray;
+	// how many of the first k elements of merge(x, y) come from x, ties going to x
+	template <class C>
+	static int coRank(int k, const T *x, int xn, const T *y, int yn, C compare) {
+		int lo = std::max(0, k - yn), hi = std::min(k, xn);
+		for (;;) {
+			int i = (lo + hi) >> 1, j = k - i;
+			if (i > 0 && j < yn && compare(y[j], x[i - 1]))
+				hi = i - 1;
+			else if (j > 0 && i < xn && !compare(y[j - 1], x[i]))
+				lo = i + 1;
+			else
+				return i;
 		}
 	}
 
+	// the two runs that a merge round of the given width joins around chunk c:
+	// [first, middle) and [middle, last)
+	static void runsAround(const std::vector<int> &bound, int width, int c, int &first, int &middle, int &last) {
+		int chunks = (int)bound.size() - 1, c0 = c - c % (width << 1);
+		first = bound[c0];
+		middle = bound[std::min(c0 + width, chunks)];
+		last = bound[std::min(c0 + (width << 1), chunks)];
+	}
+
+	// how many elements of the left run precede output chunk c in its merge
+	template <class C>
+	static int mergeSplit(const T *src, const std::vector<int> &bound, int width, int c, C compare) {
+		int first, middle, last;
+		runsAround(bound, width, c, first, middle, last);
+		return coRank(bound[c] - first, src + first, middle - first, src + middle, last - middle, compare);
+	}
+
+	// moves output chunk c of the merge into dst, given every chunk's split
+	template <class C>
+	static void mergeChunk(T *src, T *dst, const std::vector<int> &bound, const std::vector<int> &split,
+			int width, int c, C compare) {
+		int first, middle, last;
+		runsAround(bound, width, c, first, middle, last);
+		T *x = src + first + split[c], *y = src + middle + (bound[c] - first - split[c]);
+		T *xe = src + middle, *ye = src + last;
+		if (bound[c + 1] < last) {
+			xe = src + first + split[c + 1];
+			ye = src + middle + (bound[c + 1] - first - split[c + 1]);
+		}
+		T *out = dst + bound[c];
+		while (x != xe && y != ye)
+			*out++ = compare(*y, *x) ? std::move(*y++) : std::move(*x++);
+		out = std::move(x, xe, out);
+		std::move(y, ye, out);
+	}
+
 public:
 
+	/**
+	 * Plain pointers into the element buffer: usable with <algorithm> and range-for,
+	 * and invalidated by any operation that reallocates or shifts elements.
+	 */
+	typedef T* RandomAccessIterator;
+	typedef const T* ConstRandomAccessIterator;
+
 	class Iterator {
 
 	private:
@@ -85,7 +357,7 @@ public:
 				throw ElementNotExist("");
 			lastPos = nextPos;
 			++nextPos;
-			return from->get(lastPos);
+			return from->base[lastPos];
 		}
 
 		void remove() {
@@ -97,7 +369,7 @@ public:
 		}
     };
 
-	ArrayList(): base(NULL), _size(0), capacity(0) {
+	ArrayList(): base(NULL), _size(0), capacity(0), growthFactor(2.0), autoShrink(true), reserved(0) {
 	}
 
 	~ArrayList() {
@@ -108,54 +380,267 @@ public:
 		if (this != &rhs) {
 			clear();
 			rhs.cloneTo(base, _size, capacity);
+			copySettings(rhs);
 		}
 		return *this;
 	}
 
-	ArrayList(const ArrayList<T>& x): base(NULL), _size(0), capacity(0) {
+	ArrayList<T>& operator = (ArrayList<T>&& rhs) {
+		if (this != &rhs) {
+			clear();
+			base = rhs.base;
+			_size = rhs._size;
+			capacity = rhs.capacity;
+			copySettings(rhs);
+			rhs.base = NULL;
+			rhs._size = rhs.capacity = 0;
+		}
+		return *this;
+	}
+
+	ArrayList(const ArrayList<T>& x): base(NULL), _size(0), capacity(0), growthFactor(x.growthFactor), autoShrink(x.autoShrink), reserved(x.reserved) {
 		x.cloneTo(base, _size, capacity);
 	}
 
+	ArrayList(ArrayList<T>&& x):
+		base(x.base), _size(x._size), capacity(x.capacity), growthFactor(x.growthFactor), autoShrink(x.autoShrink), reserved(x.reserved) {
+		x.base = NULL;
+		x._size = x.capacity = 0;
+	}
+
 	bool add(const T& e) {
-		ensureCapacity(_size + 1);
-		base[_size++] = new T(e);
+		emplaceBack(e);
+		return true;
+	}
+
+	bool add(T&& e) {
+		emplaceBack(std::move(e));
 		return true;
 	}
 
 	void add(int idx, const T& e) {
+		emplace(idx, e);
+	}
+
+	void add(int idx, T&& e) {
+		emplace(idx, std::move(e));
+	}
+
+	template <class... Args>
+	void emplaceBack(Args&&... args) {
+		if (_size == capacity) {
+			// construct into the new buffer first: args may refer to our own elements
+			int cap = grownCapacity(_size + 1);
+			T* newArray = allocate(cap);
+			try {
+				new (newArray + _size) T(std::forward<Args>(args)...);
+			}
+			catch (...) {
+				deallocate(newArray);
+				throw;
+			}
+			relocate(base, _size, newArray);
+			if (base) deallocate(base);
+			base = newArray;
+			capacity = cap;
+		}
+		else
+			new (base + _size) T(std::forward<Args>(args)...);
+		++_size;
+	}
+
+	template <class... Args>
+	void emplace(int idx, Args&&... args) {
 		if (!(0 <= idx && idx <= _size))
 			throw IndexOutOfBound("");
+		if (idx == _size) {
+			emplaceBack(std::forward<Args>(args)...);
+			return;
+		}
+		T e(std::forward<Args>(args)...);
 		ensureCapacity(_size + 1);
-		for (int i = _size - 1; i >= idx; --i)
-			base[i + 1] = base[i];
-		base[idx] = new T(e);
+		openGap(idx);
+		new (base + idx) T(std::move(e));
 		++_size;
 	}
 
-	void clear() {
-		for (int i = 0; i < _size; ++i) {
-			if (base[i]) {
-				delete base[i];
-				base[i] = NULL;
+	/**
+	 * Appends every element of [first, last) with at most one reallocation.
+	 * The range may refer to elements of this list.
+	 */
+	template <class ForwardIterator>
+	void addAll(ForwardIterator first, ForwardIterator last) {
+		int n = (int)std::distance(first, last);
+		if (n <= 0) return;
+		if (_size + n > capacity) {
+			int cap = grownCapacity(_size + n), i = _size;
+			T* newArray = allocate(cap);
+			try {
+				for (; first != last; ++first, ++i)
+					new (newArray + i) T(*first);
+			}
+			catch (...) {
+				destroy(newArray + _size, newArray + i);
+				deallocate(newArray);
+				throw;
 			}
+			relocate(base, _size, newArray);
+			if (base) deallocate(base);
+			base = newArray;
+			capacity = cap;
+			_size += n;
 		}
-		if (base) delete[] base;
+		else {
+			for (; first != last; ++first) {
+				new (base + _size) T(*first);
+				++_size;
+			}
+		}
+	}
+
+	void addAll(const ArrayList<T>& x) {
+		addAll(x.base, x.base + x._size);
+	}
+
+	/**
+	 * Inserts [first, last) before idx with a single shift of the tail.
+	 * The range must not refer to elements of this list.
+	 */
+	template <class ForwardIterator>
+	void insertRange(int idx, ForwardIterator first, ForwardIterator last) {
+		if (!(0 <= idx && idx <= _size))
+			throw IndexOutOfBound("");
+		int n = (int)std::distance(first, last);
+		if (n <= 0) return;
+		ensureCapacity(_size + n);
+		openGap(idx, n);
+		int i = idx;
+		try {
+			for (; first != last; ++first, ++i)
+				new (base + i) T(*first);
+		}
+		catch (...) {
+			destroy(base + idx, base + i);
+			_size += n;
+			closeGap(idx, n);
+			_size -= n;
+			throw;
+		}
+		_size += n;
+	}
+
+	/**
+	 * Removes the elements in [from, to) with a single shift of the tail.
+	 */
+	void removeRange(int from, int to) {
+		if (!(0 <= from && from <= to && to <= _size))
+			throw IndexOutOfBound("");
+		if (from == to) return;
+		destroy(base + from, base + to);
+		closeGap(from, to - from);
+		_size -= to - from;
+		shrinkIfSparse();
+	}
+
+	/**
+	 * Removes every element for which pred returns true in one compaction pass.
+	 * Returns the number of removed elements.
+	 */
+	template <class Predicate>
+	int removeIf(Predicate pred) {
+		int w = 0, r = 0;
+		try {
+			for (; r < _size; ++r) {
+				if (pred(base[r]))
+					base[r].~T();
+				else {
+					if (w != r) relocate(base + r, 1, base + w);
+					++w;
+				}
+			}
+		}
+		catch (...) {
+			closeGap(w, r - w);
+			_size -= r - w;
+			throw;
+		}
+		int removed = _size - w;
+		_size = w;
+		if (removed > 0) shrinkIfSparse();
+		return removed;
+	}
+
+	/**
+	 * Makes room for at least n elements without further reallocation.
+	 * Removals never shrink the list below n again; clear() and shrinkToFit() lift that floor.
+	 */
+	void reserve(int n) {
+		if (n > reserved)
+			reserved = n;
+		if (n > capacity)
+			reallocate(n);
+	}
+
+	/**
+	 * Releases all unused capacity.
+	 */
+	void shrinkToFit() {
+		reserved = 0;
+		if (capacity != _size)
+			reallocate(_size);
+	}
+
+	int getCapacity() const {
+		return capacity;
+	}
+
+	/**
+	 * Sets the factor by which capacity grows when the list is full (2.0 by default).
+	 * Factors not greater than 1 grow by a single element.
+	 */
+	void setGrowthFactor(double factor) {
+		growthFactor = factor;
+	}
+
+	/**
+	 * Enables or disables shrinking after removals (enabled by default).
+	 * A list that is shrunk is left at twice its size.
+	 */
+	void setAutoShrink(bool enabled) {
+		autoShrink = enabled;
+	}
+
+	void clear() {
+		destroy(base, base + _size);
+		if (base) deallocate(base);
 		base = NULL;
 		_size = 0;
 		capacity = 0;
+		reserved = 0;
 	}
 
 	bool contains(const T& e) const {
-		for (int i = 0; i < _size; ++i)
-			if (*base[i] == e)
-				return true;
-		return false;
+		return indexOf(e) != -1;
+	}
+
+	/**
+	 * Returns the index of the first element equal to e, or -1 if there is none.
+	 */
+	int indexOf(const T& e) const {
+		return ArrayListScan<T>::indexOf(base, _size, e);
+	}
+
+	/**
+	 * Returns the index of the last element equal to e, or -1 if there is none.
+	 */
+	int lastIndexOf(const T& e) const {
+		return ArrayListScan<T>::lastIndexOf(base, _size, e);
 	}
 
 	const T& get(int idx) const {
 		if (!(0 <= idx && idx < _size))
 			throw IndexOutOfBound("");
-		return *base[idx];
+		return base[idx];
 	}
 
 	bool isEmpty() const {
@@ -165,40 +650,170 @@ public:
 	void removeIndex(int idx) {
 		if (!(0 <= idx && idx < _size))
 			throw IndexOutOfBound("");
-		if (base[idx]) {
-			delete base[idx];
-		}
-		for (int i = idx + 1; i < _size; ++i)
-			base[i - 1] = base[i];
-		base[--_size] = NULL;
-		trimToSize(_size);
+		base[idx].~T();
+		closeGap(idx);
+		--_size;
+		shrinkIfSparse();
 	}
 
 	bool remove(const T &e) {
-		for (int i = 0; i < _size; ++i)
-			if (*base[i] == e) {
-				removeIndex(i);
-				return true;
-			}
-		return false;
+		int i = indexOf(e);
+		if (i == -1)
+			return false;
+		removeIndex(i);
+		return true;
 	}
 
 	void set(int idx, const T& e) {
 		if (!(0 <= idx && idx < _size))
 			throw IndexOutOfBound("");
-		if (base[idx]) {
-			delete base[idx];
+		base[idx] = e;
+	}
+
+	void set(int idx, T&& e) {
+		if (!(0 <= idx && idx < _size))
+			throw IndexOutOfBound("");
+		base[idx] = std::move(e);
+	}
+
+	/**
+	 * Sorts the list in place in ascending order of compare (operator< by default).
+	 */
+	void sort() {
+		std::sort(base, base + _size);
+	}
+
+	template <class C>
+	void sort(C compare) {
+		std::sort(base, base + _size, compare);
+	}
+
+	/**
+	 * Like sort(), but keeps the relative order of equal elements.
+	 */
+	void stableSort() {
+		std::stable_sort(base, base + _size);
+	}
+
+	template <class C>
+	void stableSort(C compare) {
+		std::stable_sort(base, base + _size, compare);
+	}
+
+	/**
+	 * Sorts the list with up to threads worker threads (all hardware threads when
+	 * threads <= 0): every thread sorts one chunk, then sorted runs are merged
+	 * pairwise in log2(threads) rounds that move elements between the list and a
+	 * buffer of the same size. Each round splits its output into one chunk per
+	 * thread, cutting every merge at co-ranked positions, so all threads stay
+	 * busy through the last merge. Not stable.
+	 * An exception thrown by compare is rethrown here once all workers have
+	 * stopped; the list then holds its elements in unspecified state.
+	 */
+	void parallelSort(int threads = 0) {
+		parallelSort(threads, std::less<T>());
+	}
+
+	template <class C>
+	void parallelSort(int threads, C compare) {
+		static const int MIN_CHUNK = 1 << 14;
+		if (threads <= 0)
+			threads = std::max(1, (int)std::thread::hardware_concurrency());
+		threads = std::min(threads, _size / MIN_CHUNK);
+		if (threads <= 1) {
+			sort(compare);
+			return;
+		}
+
+		int n = _size;
+		std::vector<int> bound(threads + 1);
+		for (int i = 0; i <= threads; ++i)
+			bound[i] = (int)((long long)n * i / threads);
+		T *a = base;
+		runWorkers(threads, [&](int t) {
+			std::sort(a + bound[t], a + bound[t + 1], compare);
+		});
+
+		T *buf = allocate(n);
+		std::vector<int> built(threads, 0);
+		try {
+			runWorkers(threads, [&](int t) {
+				for (int i = bound[t]; i < bound[t + 1]; ++i, ++built[t])
+					new (buf + i) T(std::move(a[i]));
+			});
+		}
+		catch (...) {
+			for (int t = 0; t < threads; ++t)
+				destroy(buf + bound[t], buf + bound[t] + built[t]);
+			deallocate(buf);
+			throw;
+		}
+
+		T *src = buf, *dst = a;
+		try {
+			// thread t writes chunk t of each round's output; the split points are
+			// all found before any element is moved out of src
+			std::vector<int> split(threads + 1);
+			for (int width = 1; width < threads; width <<= 1) {
+				runWorkers(threads, [&](int t) {
+					split[t] = mergeSplit(src, bound, width, t, compare);
+				});
+				runWorkers(threads, [&](int t) {
+					mergeChunk(src, dst, bound, split, width, t, compare);
+				});
+				std::swap(src, dst);
+			}
+			if (src != a)
+				runWorkers(threads, [&](int t) {
+					std::move(src + bound[t], src + bound[t + 1], a + bound[t]);
+				});
 		}
-		base[idx] = new T(e);
+		catch (...) {
+			destroy(buf, buf + n);
+			deallocate(buf);
+			throw;
+		}
+		destroy(buf, buf + n);
+		deallocate(buf);
 	}
 
 	int size() const {
 		return _size;
 	}
 
+	RandomAccessIterator begin() {
+		return base;
+	}
+
+	RandomAccessIterator end() {
+		return base + _size;
+	}
+
+	ConstRandomAccessIterator begin() const {
+		return base;
+	}
+
+	ConstRandomAccessIterator end() const {
+		return base + _size;
+	}
+
+	/**
+	 * Returns the contiguous element buffer ([data(), data() + size()) is valid).
+	 */
+	T* data() {
+		return base;
+	}
+
+	const T* data() const {
+		return base;
+	}
+
 	Iterator iterator() const {
 		return Iterator( const_cast<ArrayList<T>*> (this) );
 	}
 };
 
+template <class T>
+const int ArrayList<T>::MIN_SHRINK_CAPACITY;
+
 #endif /* __ARRAYLIST_H */
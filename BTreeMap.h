@@ -0,0 +1,636 @@
+/** @file */
+
+#ifndef __BTREEMAP_H
+#define __BTREEMAP_H
+
+#include <utility>
+#include "ElementNotExist.h"
+
+/**
+ * Ordered map with the same interface as TreeMap, stored as a B+ tree.
+ *
+ * Each node packs its keys into one array spanning a few cache lines and is
+ * searched by binary search, so a lookup touches about log_B(n) nodes instead
+ * of the 2 log2(n) scattered nodes of the treap. Entries live in the leaves,
+ * which are linked in key order, so iteration is a sequential walk.
+ *
+ * Nodes hold K and V in arrays: both must be default-constructible and
+ * assignable, and every leaf slot holds a K and a V whether it is in use or not.
+ */
+template <class K, class V>
+class BTreeMap {
+private:
+	typedef K* Kp;
+	typedef V* Vp;
+
+	static const int KEY_BYTES = 256; // key array of one node: four 64-byte lines
+	static const int ORDER = sizeof(K) * 4 > KEY_BYTES ? 4 : KEY_BYTES / (int)sizeof(K);
+	static const int MIN_KEYS = (ORDER - 1) / 2; // every node but the root holds at least this many keys
+	static const int MAX_DEPTH = 32; // fanout is at least MIN_KEYS + 1 >= 2
+
+	struct Node {
+		bool leaf;
+		int count;
+		K keys[ORDER];
+		explicit Node(bool leaf): leaf(leaf), count(0) {
+		}
+	};
+
+	struct Leaf: Node {
+		V values[ORDER];
+		Leaf *prev, *next;
+		Leaf(): Node(true), prev(NULL), next(NULL) {
+		}
+	};
+
+	struct Inner: Node { // keys of child[i] are < keys[i] <= keys of child[i + 1]
+		Node *child[ORDER + 1];
+		Inner(): Node(false) {
+		}
+	};
+
+	static Leaf* asLeaf(Node *p) {
+		return static_cast<Leaf*>(p);
+	}
+
+	static Inner* asInner(Node *p) {
+		return static_cast<Inner*>(p);
+	}
+
+	int _size;
+	Node *root; // NULL when empty
+
+	// first index whose key is not less than key
+	static int lowerBound(const Node *p, const K &key) {
+		int lo = 0, hi = p->count;
+		while (lo < hi) {
+			int mid = (lo + hi) >> 1;
+			if (p->keys[mid] < key)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo;
+	}
+
+	// the child of an inner node whose range holds key
+	static int childIndex(const Node *p, const K &key) {
+		int lo = 0, hi = p->count;
+		while (lo < hi) {
+			int mid = (lo + hi) >> 1;
+			if (key < p->keys[mid])
+				hi = mid;
+			else
+				lo = mid + 1;
+		}
+		return lo;
+	}
+
+	Leaf* findLeaf(const K &key) const {
+		Node *p = root;
+		while (!p->leaf)
+			p = asInner(p)->child[childIndex(p, key)];
+		return asLeaf(p);
+	}
+
+	const V* find(const K &key) const {
+		if (root == NULL)
+			return NULL;
+		Leaf *p = findLeaf(key);
+		int i = lowerBound(p, key);
+		return i < p->count && p->keys[i] == key ? &p->values[i] : NULL;
+	}
+
+	Leaf* firstLeaf() const {
+		Node *p = root;
+		if (p == NULL)
+			return NULL;
+		while (!p->leaf)
+			p = asInner(p)->child[0];
+		return asLeaf(p);
+	}
+
+	static void deleteTree(Node *p) {
+		if (p->leaf) {
+			delete asLeaf(p);
+			return;
+		}
+		for (int i = 0; i <= p->count; ++i)
+			deleteTree(asInner(p)->child[i]);
+		delete asInner(p);
+	}
+
+	// depth is O(log_B n), so recursion stays shallow; last threads the leaf list
+	static Node* cloneTree(const Node *p, Leaf *&last) {
+		if (p->leaf) {
+			const Leaf *src = static_cast<const Leaf*>(p);
+			Leaf *ret = new Leaf();
+			try {
+				for (int i = 0; i < src->count; ++i) {
+					ret->keys[i] = src->keys[i];
+					ret->values[i] = src->values[i];
+				}
+			}
+			catch (...) {
+				delete ret;
+				throw;
+			}
+			ret->count = src->count;
+			ret->prev = last;
+			if (last) last->next = ret;
+			last = ret;
+			return ret;
+		}
+		const Inner *src = static_cast<const Inner*>(p);
+		Inner *ret = new Inner();
+		int built = 0;
+		try {
+			for (; built <= src->count; ++built)
+				ret->child[built] = cloneTree(src->child[built], last);
+			for (int i = 0; i < src->count; ++i)
+				ret->keys[i] = src->keys[i];
+		}
+		catch (...) {
+			for (int i = 0; i < built; ++i)
+				deleteTree(ret->child[i]);
+			delete ret;
+			throw;
+		}
+		ret->count = src->count;
+		return ret;
+	}
+
+	void cloneFrom(const BTreeMap<K, V> &other) {
+		Leaf *last = NULL;
+		root = other.root ? cloneTree(other.root, last) : NULL;
+		_size = other._size;
+	}
+
+	// moves the upper half of full leaf p into a new right sibling
+	static Leaf* splitLeaf(Leaf *p) {
+		Leaf *q = new Leaf();
+		int keep = ORDER / 2;
+		for (int i = keep; i < ORDER; ++i) {
+			q->keys[i - keep] = std::move(p->keys[i]);
+			q->values[i - keep] = std::move(p->values[i]);
+		}
+		q->count = ORDER - keep;
+		p->count = keep;
+		q->next = p->next;
+		if (q->next) q->next->prev = q;
+		q->prev = p;
+		p->next = q;
+		return q;
+	}
+
+	// moves the keys above the middle of full inner node p into a new right sibling;
+	// the middle key moves up into sep
+	static Inner* splitInner(Inner *p, K &sep) {
+		Inner *q = new Inner();
+		int mid = ORDER / 2;
+		sep = std::move(p->keys[mid]);
+		for (int i = mid + 1; i < ORDER; ++i)
+			q->keys[i - mid - 1] = std::move(p->keys[i]);
+		for (int i = mid + 1; i <= ORDER; ++i)
+			q->child[i - mid - 1] = p->child[i];
+		q->count = ORDER - mid - 1;
+		p->count = mid;
+		return q;
+	}
+
+	// inserts sep and its right child at key position i of a non-full inner node
+	static void insertAt(Inner *p, int i, K &sep, Node *right) {
+		for (int j = p->count; j > i; --j) {
+			p->keys[j] = std::move(p->keys[j - 1]);
+			p->child[j + 1] = p->child[j];
+		}
+		p->keys[i] = std::move(sep);
+		p->child[i + 1] = right;
+		++p->count;
+	}
+
+	bool insert(const K &key, const V &value) {
+		if (root == NULL)
+			root = new Leaf();
+		Inner *path[MAX_DEPTH];
+		int slot[MAX_DEPTH], depth = 0;
+		Node *p = root;
+		while (!p->leaf) {
+			path[depth] = asInner(p);
+			slot[depth] = childIndex(p, key);
+			p = asInner(p)->child[slot[depth++]];
+		}
+		Leaf *leaf = asLeaf(p);
+		int i = lowerBound(leaf, key);
+		if (i < leaf->count && leaf->keys[i] == key) {
+			leaf->values[i] = value;
+			return false;
+		}
+
+		Node *right = NULL;
+		K sep;
+		if (leaf->count == ORDER) {
+			Leaf *q = splitLeaf(leaf);
+			if (i > leaf->count) {
+				i -= leaf->count;
+				leaf = q;
+			}
+			right = q;
+		}
+		for (int j = leaf->count; j > i; --j) {
+			leaf->keys[j] = std::move(leaf->keys[j - 1]);
+			leaf->values[j] = std::move(leaf->values[j - 1]);
+		}
+		leaf->keys[i] = key;
+		leaf->values[i] = value;
+		++leaf->count;
+		if (right)
+			sep = right->keys[0];
+
+		while (right && depth > 0) { // push the split up the path
+			Inner *parent = path[--depth];
+			int at = slot[depth];
+			if (parent->count < ORDER) {
+				insertAt(parent, at, sep, right);
+				right = NULL;
+			}
+			else {
+				K up;
+				Inner *q = splitInner(parent, up);
+				if (at <= parent->count)
+					insertAt(parent, at, sep, right);
+				else
+					insertAt(q, at - parent->count - 1, sep, right);
+				sep = std::move(up);
+				right = q;
+			}
+		}
+		if (right) { // the root split
+			Inner *r = new Inner();
+			r->keys[0] = std::move(sep);
+			r->child[0] = root;
+			r->child[1] = right;
+			r->count = 1;
+			root = r;
+		}
+		return true;
+	}
+
+	// removes key position i (and the child to its right) from an inner node
+	static void removeAt(Inner *p, int i) {
+		for (int j = i; j + 1 < p->count; ++j) {
+			p->keys[j] = std::move(p->keys[j + 1]);
+			p->child[j + 1] = p->child[j + 2];
+		}
+		--p->count;
+	}
+
+	// child ci of parent has fallen below MIN_KEYS: borrow from a sibling, or merge with one
+	static void rebalance(Inner *parent, int ci) {
+		Node *p = parent->child[ci];
+		Node *left = ci > 0 ? parent->child[ci - 1] : NULL;
+		Node *right = ci < parent->count ? parent->child[ci + 1] : NULL;
+		if (left && left->count > MIN_KEYS) {
+			for (int j = p->count; j > 0; --j)
+				p->keys[j] = std::move(p->keys[j - 1]);
+			if (p->leaf) {
+				for (int j = p->count; j > 0; --j)
+					asLeaf(p)->values[j] = std::move(asLeaf(p)->values[j - 1]);
+				p->keys[0] = std::move(left->keys[left->count - 1]);
+				asLeaf(p)->values[0] = std::move(asLeaf(left)->values[left->count - 1]);
+				parent->keys[ci - 1] = p->keys[0];
+			}
+			else {
+				for (int j = p->count + 1; j > 0; --j)
+					asInner(p)->child[j] = asInner(p)->child[j - 1];
+				p->keys[0] = std::move(parent->keys[ci - 1]);
+				asInner(p)->child[0] = asInner(left)->child[left->count];
+				parent->keys[ci - 1] = std::move(left->keys[left->count - 1]);
+			}
+			++p->count;
+			--left->count;
+		}
+		else if (right && right->count > MIN_KEYS) {
+			if (p->leaf) {
+				p->keys[p->count] = std::move(right->keys[0]);
+				asLeaf(p)->values[p->count] = std::move(asLeaf(right)->values[0]);
+				for (int j = 0; j + 1 < right->count; ++j) {
+					right->keys[j] = std::move(right->keys[j + 1]);
+					asLeaf(right)->values[j] = std::move(asLeaf(right)->values[j + 1]);
+				}
+				parent->keys[ci] = right->keys[0];
+			}
+			else {
+				p->keys[p->count] = std::move(parent->keys[ci]);
+				asInner(p)->child[p->count + 1] = asInner(right)->child[0];
+				parent->keys[ci] = std::move(right->keys[0]);
+				for (int j = 0; j + 1 < right->count; ++j)
+					right->keys[j] = std::move(right->keys[j + 1]);
+				for (int j = 0; j < right->count; ++j)
+					asInner(right)->child[j] = asInner(right)->child[j + 1];
+			}
+			++p->count;
+			--right->count;
+		}
+		else if (left)
+			merge(parent, ci - 1);
+		else
+			merge(parent, ci);
+	}
+
+	// appends child k + 1 of parent to child k, with separator k between them for inner nodes
+	static void merge(Inner *parent, int k) {
+		Node *l = parent->child[k], *r = parent->child[k + 1];
+		if (l->leaf) {
+			Leaf *a = asLeaf(l), *b = asLeaf(r);
+			for (int j = 0; j < b->count; ++j) {
+				a->keys[a->count + j] = std::move(b->keys[j]);
+				a->values[a->count + j] = std::move(b->values[j]);
+			}
+			a->count += b->count;
+			a->next = b->next;
+			if (a->next) a->next->prev = a;
+			delete b;
+		}
+		else {
+			Inner *a = asInner(l), *b = asInner(r);
+			a->keys[a->count] = std::move(parent->keys[k]);
+			for (int j = 0; j < b->count; ++j)
+				a->keys[a->count + 1 + j] = std::move(b->keys[j]);
+			for (int j = 0; j <= b->count; ++j)
+				a->child[a->count + 1 + j] = b->child[j];
+			a->count += b->count + 1;
+			delete b;
+		}
+		removeAt(parent, k);
+	}
+
+	bool erase(const K &key) {
+		if (root == NULL)
+			return false;
+		Inner *path[MAX_DEPTH];
+		int slot[MAX_DEPTH], depth = 0;
+		Node *p = root;
+		while (!p->leaf) {
+			path[depth] = asInner(p);
+			slot[depth] = childIndex(p, key);
+			p = asInner(p)->child[slot[depth++]];
+		}
+		Leaf *leaf = asLeaf(p);
+		int i = lowerBound(leaf, key);
+		if (i == leaf->count || !(leaf->keys[i] == key))
+			return false;
+		for (int j = i; j + 1 < leaf->count; ++j) {
+			leaf->keys[j] = std::move(leaf->keys[j + 1]);
+			leaf->values[j] = std::move(leaf->values[j + 1]);
+		}
+		--leaf->count;
+
+		// separators equal to the removed key stay valid bounds, so only underflow needs fixing
+		for (p = leaf; depth > 0 && p->count < MIN_KEYS; ) {
+			Inner *parent = path[--depth];
+			rebalance(parent, slot[depth]);
+			p = parent;
+		}
+		if (root->count == 0) {
+			Node *old = root;
+			if (old->leaf) {
+				root = NULL;
+				delete asLeaf(old);
+			}
+			else {
+				root = asInner(old)->child[0];
+				delete asInner(old);
+			}
+		}
+		return true;
+	}
+
+public:
+	class Entry {
+		friend BTreeMap;
+	private:
+		Kp key;
+		Vp value;
+	public:
+		Entry(): key(NULL), value(NULL) {
+		}
+		Entry(const K &key, const V &value): key(new K(key)), value(new V(value)) {
+		}
+		Entry(const Entry &other): key(other.key ? new K(*other.key) : NULL), value(other.value ? new V(*other.value) : NULL) {
+		}
+		Entry& operator = (const Entry &other) {
+			if (this != &other) {
+				if (key) delete key;
+				if (value) delete value;
+				key = other.key ? new K(*other.key) : NULL;
+				value = other.value ? new V(*other.value) : NULL;
+			}
+			return *this;
+		}
+		const K& getKey() const {
+			return *key;
+		}
+		const V& getValue() const {
+			return *value;
+		}
+		~Entry() {
+			if (key) delete key;
+			if (value) delete value;
+		}
+	};
+
+	/**
+	 * Non-owning view of an entry, valid until the map is next modified.
+	 */
+	class EntryRef {
+	private:
+		const K *key;
+		const V *value;
+	public:
+		EntryRef(const K &key, const V &value): key(&key), value(&value) {
+		}
+		const K& getKey() const {
+			return *key;
+		}
+		const V& getValue() const {
+			return *value;
+		}
+	};
+
+	/**
+	 * Like EntryRef, but the value may be modified in place.
+	 */
+	class MutableEntryRef {
+	private:
+		const K *key;
+		V *value;
+	public:
+		MutableEntryRef(const K &key, V &value): key(&key), value(&value) {
+		}
+		const K& getKey() const {
+			return *key;
+		}
+		V& getValue() const {
+			return *value;
+		}
+		void setValue(const V &v) const {
+			*value = v;
+		}
+	};
+
+	class Iterator {
+	private:
+		Leaf *p;
+		int i;
+
+	public:
+		Iterator(): p(NULL), i(0) {
+		}
+
+		explicit Iterator(Leaf *first): p(first), i(0) {
+		}
+
+		bool hasNext() const {
+			return p != NULL && i < p->count;
+		}
+
+		const Entry next() {
+			EntryRef e = nextRef();
+			return Entry(e.getKey(), e.getValue());
+		}
+
+		/**
+		 * Like next(), but returns a view of the entry instead of copying it.
+		 */
+		EntryRef nextRef() {
+			if (!hasNext())
+				throw ElementNotExist("");
+			Leaf *q = p;
+			int j = i++;
+			if (i == p->count) {
+				p = p->next;
+				i = 0;
+			}
+			return EntryRef(q->keys[j], q->values[j]);
+		}
+	};
+
+	class MutableIterator {
+	private:
+		Leaf *p;
+		int i;
+
+	public:
+		MutableIterator(): p(NULL), i(0) {
+		}
+
+		explicit MutableIterator(Leaf *first): p(first), i(0) {
+		}
+
+		bool hasNext() const {
+			return p != NULL && i < p->count;
+		}
+
+		MutableEntryRef next() {
+			if (!hasNext())
+				throw ElementNotExist("");
+			Leaf *q = p;
+			int j = i++;
+			if (i == p->count) {
+				p = p->next;
+				i = 0;
+			}
+			return MutableEntryRef(q->keys[j], q->values[j]);
+		}
+	};
+
+	BTreeMap(): _size(0), root(NULL) {
+	}
+
+	BTreeMap(const BTreeMap<K, V> &x): _size(0), root(NULL) {
+		cloneFrom(x);
+	}
+
+	~BTreeMap() {
+		clear();
+	}
+
+	BTreeMap<K, V>& operator = (const BTreeMap<K, V> &x) {
+		if (this != &x) {
+			clear();
+			cloneFrom(x);
+		}
+		return *this;
+	}
+
+	Iterator iterator() const {
+		return Iterator(firstLeaf());
+	}
+
+	/**
+	 * Iterates in key order like iterator(), allowing values to be updated in place.
+	 */
+	MutableIterator mutableIterator() {
+		return MutableIterator(firstLeaf());
+	}
+
+	void clear() {
+		if (root)
+			deleteTree(root);
+		root = NULL;
+		_size = 0;
+	}
+
+	bool containsKey(const K &key) const {
+		return find(key) != NULL;
+	}
+
+	bool containsValue(const V &value) const {
+		for (Leaf *p = firstLeaf(); p; p = p->next)
+			for (int i = 0; i < p->count; ++i)
+				if (p->values[i] == value)
+					return true;
+		return false;
+	}
+
+	const V& get(const K &key) const {
+		const V *ret = find(key);
+		if (ret == NULL)
+			throw ElementNotExist("");
+		return *ret;
+	}
+
+	bool isEmpty() const {
+		return _size == 0;
+	}
+
+	void put(const K &key, const V &value) {
+		if (insert(key, value))
+			++_size;
+	}
+
+	void remove(const K &key) {
+		if (!erase(key))
+			throw ElementNotExist("");
+		--_size;
+	}
+
+	int size() const {
+		return _size;
+	}
+};
+
+template <class K, class V>
+const int BTreeMap<K, V>::KEY_BYTES;
+
+template <class K, class V>
+const int BTreeMap<K, V>::ORDER;
+
+template <class K, class V>
+const int BTreeMap<K, V>::MIN_KEYS;
+
+template <class K, class V>
+const int BTreeMap<K, V>::MAX_DEPTH;
+
+#endif /* __BTREEMAP_H */
@@ -0,0 +1,430 @@
+/** @file ChainedHashTable.h
+ * The chained table under HashMap and HashSet.
+ *
+ * Entries live in pooled nodes that hold the key, the value and the cached
+ * hash code inline. Each node is on the chain of its bucket and on a doubly
+ * linked insertion-order list through header. Bucket counts come from
+ * HashTableSizes; a resize may move the old buckets a few at a time.
+ */
+
+#ifndef __CHAINEDHASHTABLE_H
+#define __CHAINEDHASHTABLE_H
+
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "Hash.h"
+#include "HashTableSizes.h"
+#include "NodePool.h"
+
+template<class K, class V, class H>
+class ChainedHashTable: protected HashTableSizes<> {
+protected:
+	class Node {
+	public:
+		int hashCode;
+		Node *next, *l, *r;
+
+		// key and value are constructed in place for entry nodes only, never for the header
+		typename std::aligned_storage<sizeof(K), std::alignment_of<K>::value>::type keyStorage;
+		typename std::aligned_storage<sizeof(V), std::alignment_of<V>::value>::type valueStorage;
+
+		Node(): hashCode(0), next(NULL), l(this), r(this) {
+		}
+
+		template <class KArg, class VArg>
+		Node(KArg &&key, VArg &&value, int hashCode): hashCode(hashCode), next(NULL), l(NULL), r(NULL) {
+			new (&keyStorage) K(std::forward<KArg>(key));
+			try {
+				new (&valueStorage) V(std::forward<VArg>(value));
+			}
+			catch (...) {
+				this->key().~K();
+				throw;
+			}
+		}
+
+		K& key() {
+			return *reinterpret_cast<K*>(&keyStorage);
+		}
+
+		V& value() {
+			return *reinterpret_cast<V*>(&valueStorage);
+		}
+	};
+
+	typedef Node *List;
+
+	const static int REHASH_STEP = 16; // old buckets migrated per insert/remove while resizing incrementally
+
+	H getHashCode;
+	int _size;
+	int hashModPtr, capacity;
+	int reservedModPtr; // slot asked for by the sized constructor or reserve(); auto-shrinking stops there
+	List header;
+	List *pool;
+	NodePool<Node> nodes;
+
+	// incremental resize: buckets [migrated, oldCapacity) of oldPool are not moved to pool yet
+	bool incremental, autoShrink;
+	int oldCapacity, migrated;
+	List *oldPool;
+
+	// bucket arrays come from calloc (NULL is all zero bits): a large one is mapped in as
+	// zero pages on first touch, so an incremental resize does not clear it all in one put
+	static List* newBuckets(int n) {
+		List *p = static_cast<List*>(std::calloc(n, sizeof(List)));
+		if (p == NULL)
+			throw std::bad_alloc();
+		return p;
+	}
+
+	static void freeBuckets(List *p) {
+		std::free(p);
+	}
+
+	static int bucketIndex(int code, int cap) {
+		int h = code % cap;
+		if (h < 0) h += cap;
+		return h;
+	}
+
+	// the chain that holds, or would receive, a key with this hash code
+	List& bucket(int code) const {
+		if (oldPool) {
+			int h = bucketIndex(code, oldCapacity);
+			if (h >= migrated)
+				return oldPool[h];
+		}
+		return pool[bucketIndex(code, capacity)];
+	}
+
+	List newNode(const K &key, const V &value, int code) {
+		List p = nodes.allocate();
+		try {
+			return new (p) Node(key, value, code);
+		}
+		catch (...) {
+			nodes.deallocate(p);
+			throw;
+		}
+	}
+
+	void deleteNode(List p) {
+		p->key().~K();
+		p->value().~V();
+		nodes.deallocate(p);
+	}
+
+	// links a new entry into head and at the back of the insertion-order list, without growing
+	List linkNode(List &head, const K &key, const V &value, int code) {
+		List p = newNode(key, value, code), l = p->l = header->l, r = p->r = header;
+		l->r = r->l = p;
+		p->next = head;
+		head = p;
+		++_size;
+		return p;
+	}
+
+	List link(List &head, const K &key, const V &value, int code) {
+		List p = linkNode(head, key, value, code);
+		ensureCapacity(_size);
+		return p;
+	}
+
+	// unlinks p from its chain and the insertion-order list and frees it, without shrinking
+	void unlinkNode(List p) {
+		List *link = &bucket(p->hashCode);
+		while (*link != p)
+			link = &(*link)->next;
+		*link = p->next;
+		List l = p->l, r = p->r;
+		l->r = r;
+		r->l = l;
+		deleteNode(p);
+		--_size;
+	}
+
+	void eraseNode(List p) {
+		unlinkNode(p);
+		shrinkIfSparse();
+	}
+
+	// moves p to the back of the insertion-order list, in O(1)
+	void moveToBack(List p) {
+		if (p->r == header)
+			return;
+		p->l->r = p->r;
+		p->r->l = p->l;
+		List l = p->l = header->l, r = p->r = header;
+		l->r = r->l = p;
+	}
+
+	static List findIn(List head, const K &key, int code) {
+		for (List p = head; p; p = p->next)
+			if (p->hashCode == code && p->key() == key)
+				return p;
+		return NULL;
+	}
+
+	List findNode(const K &key, int code) const {
+		return findIn(bucket(code), key, code);
+	}
+
+	void migrate(int buckets) {
+		for (; oldPool && buckets > 0; --buckets) {
+			for (List p = oldPool[migrated], next; p; p = next) {
+				next = p->next;
+				int h = bucketIndex(p->hashCode, capacity);
+				p->next = pool[h];
+				pool[h] = p;
+			}
+			oldPool[migrated] = NULL;
+			if (++migrated == oldCapacity) {
+				freeBuckets(oldPool);
+				oldPool = NULL;
+				oldCapacity = migrated = 0;
+			}
+		}
+	}
+
+	void rehashAll() {
+		if (oldPool) {
+			freeBuckets(oldPool);
+			oldPool = NULL;
+			oldCapacity = migrated = 0;
+		}
+		List* newPool = newBuckets(capacity);
+		for (List p = header->r; p != header; p = p->r) {
+			int h = bucketIndex(p->hashCode, capacity);
+			p->next = newPool[h];
+			newPool[h] = p;
+		}
+		freeBuckets(pool);
+		pool = newPool;
+	}
+
+	void resizeTo(int ptr) {
+		int previous = capacity;
+		hashModPtr = ptr;
+		capacity = TABLE_SIZE[ptr];
+		if (!incremental || oldPool) { // a migration still in progress is finished in the same pass
+			rehashAll();
+			return;
+		}
+		oldPool = pool;
+		oldCapacity = previous;
+		migrated = 0;
+		pool = newBuckets(capacity);
+	}
+
+	// grows, in a single rehash, to the slot that holds n entries; unlike reserve()
+	// it leaves the auto-shrink floor alone, so bulk inserts can size up front
+	void growTo(int n) {
+		int ptr = slotFor(n);
+		if (ptr > hashModPtr) {
+			hashModPtr = ptr;
+			capacity = TABLE_SIZE[ptr];
+			rehashAll();
+		}
+	}
+
+	void ensureCapacity(int cap) {
+		if (capacity * 0.50 < cap)
+			resizeTo(hashModPtr + 1);
+	}
+
+	void shrinkIfSparse() {
+		if (autoShrink) {
+			int ptr = shrinkSlot(hashModPtr, reservedModPtr, _size);
+			if (ptr < hashModPtr)
+				resizeTo(ptr);
+		}
+	}
+
+	void cloneTo(int &otherSize, int &otherHashModPtr, int &otherCapacity, List &otherHeader, List* &otherPool, NodePool<Node> &otherNodes) const {
+		otherSize = _size;
+		otherHashModPtr = hashModPtr;
+		otherCapacity = capacity;
+		otherHeader = new Node();
+		otherPool = newBuckets(capacity);
+		for (List p = header->r; p != header; p = p->r) {
+			List element = new (otherNodes.allocate()) Node(p->key(), p->value(), p->hashCode);
+			List l = element->l = otherHeader->l, r = element->r = otherHeader;
+			l->r = r->l = element;
+			int h = bucketIndex(element->hashCode, capacity);
+			element->next = otherPool[h];
+			otherPool[h] = element;
+		}
+	}
+
+	void destroy() { // everything but header is cleared
+		_size = 0;
+		hashModPtr = 0;
+		capacity = 0;
+		freeBuckets(pool);
+		freeBuckets(oldPool);
+		pool = oldPool = NULL;
+		oldCapacity = migrated = 0;
+
+		// trivially destructible entries need no walk: dropping the slabs frees them all
+		if (!std::is_trivially_destructible<K>::value || !std::is_trivially_destructible<V>::value)
+			for (List p = header->r, next; p != header; p = next) {
+				next = p->r;
+				p->key().~K();
+				p->value().~V();
+			}
+		nodes.release();
+		header->l = header->r = header;
+	}
+
+	ChainedHashTable():
+		getHashCode(), _size(0), hashModPtr(0), capacity(TABLE_SIZE[0]), reservedModPtr(0),
+		header(new Node()),
+		pool(newBuckets(capacity)),
+		incremental(false), autoShrink(true), oldCapacity(0), migrated(0), oldPool(NULL) {
+	}
+
+	explicit ChainedHashTable(int expectedSize):
+		getHashCode(), _size(0), hashModPtr(slotFor(expectedSize)), capacity(TABLE_SIZE[hashModPtr]),
+		reservedModPtr(hashModPtr), header(new Node()),
+		pool(newBuckets(capacity)),
+		incremental(false), autoShrink(true), oldCapacity(0), migrated(0), oldPool(NULL) {
+	}
+
+	ChainedHashTable(const ChainedHashTable<K, V, H> &other):
+		getHashCode(other.getHashCode), _size(0), hashModPtr(0), capacity(0), reservedModPtr(other.reservedModPtr),
+		header(NULL), pool(NULL),
+		incremental(other.incremental), autoShrink(other.autoShrink), oldCapacity(0), migrated(0), oldPool(NULL) {
+		other.cloneTo(_size, hashModPtr, capacity, header, pool, nodes);
+	}
+
+	~ChainedHashTable() {
+		destroy();
+		delete header;
+		header = NULL;
+	}
+
+	ChainedHashTable<K, V, H>& operator = (const ChainedHashTable<K, V, H> &other) {
+		if (this != &other) {
+			destroy();
+			delete header;
+			header = NULL;
+			getHashCode = other.getHashCode;
+			incremental = other.incremental;
+			autoShrink = other.autoShrink;
+			reservedModPtr = other.reservedModPtr;
+			other.cloneTo(_size, hashModPtr, capacity, header, pool, nodes);
+		}
+		return *this;
+	}
+
+public:
+	void clear() {
+		destroy();
+		reservedModPtr = 0;
+		capacity = TABLE_SIZE[0];
+		pool = newBuckets(capacity);
+	}
+
+	/**
+	 * In incremental mode a resize keeps the old bucket array and moves
+	 * REHASH_STEP of its buckets per insert/remove instead of rehashing
+	 * everything at once; lookups consult both arrays until the move is
+	 * complete. Lookups never migrate, so const access stays free of writes.
+	 * Turning the mode off finishes any migration in progress.
+	 */
+	void setIncrementalRehash(bool enabled) {
+		incremental = enabled;
+		if (!enabled && oldPool)
+			rehashAll();
+	}
+
+	/**
+	 * Enables or disables shrinking the bucket array after removals (enabled by default).
+	 */
+	void setAutoShrink(bool enabled) {
+		autoShrink = enabled;
+	}
+
+	/**
+	 * Returns H's hash code for key. Callers that look the same key up
+	 * repeatedly, or in several tables sharing H, can compute it once and pass
+	 * it to the overloads that take a hash code; passing any other value for
+	 * key is undefined.
+	 */
+	int hashOf(const K &key) const {
+		return getHashCode.hashCode(key);
+	}
+
+	bool isEmpty() const {
+		return _size == 0;
+	}
+
+	int size() const {
+		return _size;
+	}
+
+	/**
+	 * Grows the bucket array, in a single rehash, to the size that holds n entries.
+	 * Auto-shrinking keeps at least that size until clear() or compact().
+	 */
+	void reserve(int n) {
+		int ptr = slotFor(n);
+		if (ptr > reservedModPtr)
+			reservedModPtr = ptr;
+		growTo(n);
+	}
+
+	/**
+	 * Shrinks the bucket array to the smallest size that holds the current entries
+	 * and repacks the nodes into fresh slabs, returning all free node memory.
+	 * Drops any size kept by reserve().
+	 * Invalidates pointers and references obtained from tryGet, getOrInsert and the like.
+	 */
+	void compact() {
+		NodePool<Node> packed;
+		for (List p = header->r; p != header; p = p->r) {
+			List q = new (packed.allocate()) Node(std::move(p->key()), std::move(p->value()), p->hashCode);
+			p->key().~K();
+			p->value().~V();
+			q->l = p->l;
+			q->r = p->r;
+			q->l->r = q->r->l = q;
+			p = q;
+		}
+		nodes.swap(packed);
+		packed.release();
+		reservedModPtr = 0;
+		hashModPtr = slotFor(_size);
+		capacity = TABLE_SIZE[hashModPtr];
+		rehashAll();
+	}
+
+	struct MemoryUsage {
+		size_t buckets; // bucket arrays, including one still being migrated
+		size_t nodes; // node slabs, used and free, plus the header node
+		size_t keyBytes, valueBytes; // the part of nodes taken by inline keys and values
+		size_t total; // all of the above and the table object itself
+	};
+
+	/**
+	 * Reports the memory held by the table. Heap memory owned by the keys and
+	 * values themselves (string contents, for example) is not included.
+	 */
+	MemoryUsage memoryUsage() const {
+		MemoryUsage usage;
+		usage.buckets = ((size_t)capacity + (oldPool ? oldCapacity : 0)) * sizeof(List);
+		usage.nodes = nodes.bytesReserved() + sizeof(Node);
+		usage.keyBytes = (size_t)_size * sizeof(K);
+		usage.valueBytes = std::is_empty<V>::value ? 0 : (size_t)_size * sizeof(V);
+		usage.total = sizeof(*this) + usage.buckets + usage.nodes;
+		return usage;
+	}
+};
+
+template <class K, class V, class H>
+const int ChainedHashTable<K, V, H>::REHASH_STEP;
+
+#endif /* __CHAINEDHASHTABLE_H */
@@ -0,0 +1,430 @@
+/** @file */
+
+#ifndef __CONCURRENTHASHMAP_H
+#define __CONCURRENTHASHMAP_H
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "ElementNotExist.h"
+#include "Hash.h"
+#include "HashTableSizes.h"
+
+/**
+ * Thread-safe hash map with the bucket layout of HashMap<K, V, H>.
+ *
+ * Writers lock one of STRIPES mutexes (chosen by bucket index) and publish
+ * changes with atomic stores, so readers walk the chains without any lock.
+ * Nodes are immutable once linked: put on an existing key links a fresh node
+ * in place of the old one. Unlinked nodes and old bucket arrays are freed by
+ * epoch-based reclamation once no reader that could still see them remains:
+ * each thread slot keeps its own retire list tagged with the epoch, and the
+ * epoch is moved on by a compare-and-swap that never waits for readers.
+ * The size is kept as one counter per thread slot and summed on demand.
+ *
+ * A resize is started by the writer that pushes the load past 0.5. It takes
+ * every stripe lock and then copies the buckets into the next TABLE_SIZE
+ * array in chunks; writers that arrive meanwhile claim chunks and help copy
+ * before they wait for their stripe. Readers keep using the old array until
+ * the new one is published.
+ *
+ * Values are returned by copy, since a reference could outlive the node.
+ */
+template<class K, class V, class H = DefaultHash<K> >
+class ConcurrentHashMap: private HashTableSizes<> {
+private:
+	static const int STRIPES = 64; // power of two
+	static const int THREAD_SLOTS = 64; // power of two
+	static const int TRANSFER_CHUNK = 1024; // buckets copied per claim during a resize
+	static const int RECLAIM_THRESHOLD = 256; // objects retired to one slot between reclamation passes
+	static const int SIZE_CHECK = 16; // adds to one slot between load checks, once the table is large
+
+	struct Node {
+		const int hashCode;
+		const K key;
+		const V value;
+		std::atomic<Node*> next;
+		Node *retiredNext;
+		unsigned retiredEpoch;
+
+		Node(int hashCode, const K &key, const V &value, Node *next):
+			hashCode(hashCode), key(key), value(value), next(next), retiredNext(NULL), retiredEpoch(0) {
+		}
+	};
+
+	struct Table {
+		int hashModPtr, capacity;
+		std::atomic<Node*> *buckets;
+		Table *retiredNext;
+		unsigned retiredEpoch;
+
+		explicit Table(int hashModPtr):
+			hashModPtr(hashModPtr), capacity(TABLE_SIZE[hashModPtr]), buckets(new std::atomic<Node*>[capacity]),
+			retiredNext(NULL), retiredEpoch(0) {
+			for (int i = 0; i < capacity; ++i)
+				buckets[i].store(NULL, std::memory_order_relaxed);
+		}
+
+		~Table() { // frees the nodes as well: a retired table takes its chains with it
+			for (int i = 0; i < capacity; ++i)
+				for (Node *p = buckets[i].load(std::memory_order_relaxed), *next; p; p = next) {
+					next = p->next.load(std::memory_order_relaxed);
+					delete p;
+				}
+			delete[] buckets;
+		}
+	};
+
+	struct Transfer {
+		Table *from, *to;
+		int chunks;
+		std::atomic<int> nextChunk, chunksDone;
+		Transfer *retiredNext;
+		unsigned retiredEpoch;
+
+		Transfer(Table *from, Table *to):
+			from(from), to(to), chunks((from->capacity + TRANSFER_CHUNK - 1) / TRANSFER_CHUNK),
+			nextChunk(0), chunksDone(0), retiredNext(NULL), retiredEpoch(0) {
+		}
+	};
+
+	struct alignas(64) Stripe {
+		std::mutex lock;
+	};
+
+	// state of the threads that hash to one slot; mostly touched by a single thread
+	struct alignas(64) ThreadSlot {
+		std::atomic<int> active[2]; // readers inside a critical section, by epoch parity
+		std::atomic<int> sizeDelta; // entries added minus entries removed, written under a stripe lock
+	};
+
+	// objects unlinked by the threads of one slot, newest first, each tagged with the epoch it was retired in
+	struct alignas(64) RetireList {
+		std::mutex lock;
+		Node *nodes;
+		Table *tables;
+		Transfer *transfers;
+		int pending; // retired since the last reclamation pass
+	};
+
+	// marks the calling thread as a reader for its lifetime
+	class ReadGuard {
+	private:
+		std::atomic<int> *counter;
+	public:
+		explicit ReadGuard(const ConcurrentHashMap<K, V, H> &map) {
+			ThreadSlot &slot = map.slots[threadSlot()];
+			for (;;) {
+				unsigned e = map.epoch.load();
+				counter = &slot.active[e & 1];
+				counter->fetch_add(1);
+				if (map.epoch.load() == e)
+					return;
+				counter->fetch_sub(1); // a reclamation flipped the epoch: register under the new one
+			}
+		}
+		~ReadGuard() {
+			counter->fetch_sub(1);
+		}
+	};
+
+	H getHashCode;
+
+	std::atomic<Table*> table;
+	std::atomic<Transfer*> transfer;
+	mutable Stripe stripes[STRIPES];
+
+	mutable ThreadSlot slots[THREAD_SLOTS];
+	mutable std::atomic<unsigned> epoch;
+	RetireList retired[THREAD_SLOTS];
+
+	ConcurrentHashMap(const ConcurrentHashMap<K, V, H> &);
+	ConcurrentHashMap<K, V, H>& operator = (const ConcurrentHashMap<K, V, H> &);
+
+	static int threadSlot() {
+		static thread_local int slot = (int)(std::hash<std::thread::id>()(std::this_thread::get_id()) & (THREAD_SLOTS - 1));
+		return slot;
+	}
+
+	static int bucketIndex(int code, int cap) {
+		int h = code % cap;
+		if (h < 0) h += cap;
+		return h;
+	}
+
+	std::mutex& stripeOf(int bucket) const {
+		return stripes[bucket & (STRIPES - 1)].lock;
+	}
+
+	void lockAll() {
+		for (int i = 0; i < STRIPES; ++i)
+			stripes[i].lock.lock();
+	}
+
+	void unlockAll() {
+		for (int i = STRIPES - 1; i >= 0; --i)
+			stripes[i].lock.unlock();
+	}
+
+	// moves the epoch from e to e + 1 once no reader is left in e - 1; never waits.
+	// Readers of e + 1 share that parity, but none can have entered it yet.
+	void tryAdvance() {
+		unsigned e = epoch.load();
+		for (int i = 0; i < THREAD_SLOTS; ++i)
+			if (slots[i].active[(e + 1) & 1].load() != 0)
+				return;
+		epoch.compare_exchange_strong(e, e + 1);
+	}
+
+	// an object retired in epoch r was unlinked before any reader of r + 1 entered;
+	// once the epoch reaches r + 2, no reader of r or earlier is left
+	template <class T>
+	static int freeRetired(T *&list, unsigned e, bool all) {
+		T **link = &list;
+		while (*link && !all && e - (*link)->retiredEpoch < 2)
+			link = &(*link)->retiredNext;
+		int freed = 0;
+		for (T *p = *link, *next; p; p = next, ++freed) {
+			next = p->retiredNext;
+			delete p;
+		}
+		*link = NULL;
+		return freed;
+	}
+
+	void retire(Node *p, Table *t, Transfer *tr) {
+		RetireList &list = retired[threadSlot()];
+		std::lock_guard<std::mutex> guard(list.lock);
+		unsigned e = epoch.load();
+		if (p) {
+			p->retiredEpoch = e;
+			p->retiredNext = list.nodes;
+			list.nodes = p;
+		}
+		if (t) {
+			t->retiredEpoch = e;
+			t->retiredNext = list.tables;
+			list.tables = t;
+		}
+		if (tr) {
+			tr->retiredEpoch = e;
+			tr->retiredNext = list.transfers;
+			list.transfers = tr;
+		}
+		if (++list.pending >= RECLAIM_THRESHOLD || t) { // old bucket arrays are large: try to free them early
+			tryAdvance();
+			e = epoch.load();
+			freeRetired(list.nodes, e, false);
+			freeRetired(list.tables, e, false);
+			freeRetired(list.transfers, e, false);
+			list.pending = 0;
+		}
+	}
+
+	// sums the per-slot counters; exact when no writer is running
+	int countEntries() const {
+		int n = 0;
+		for (int i = 0; i < THREAD_SLOTS; ++i)
+			n += slots[i].sizeDelta.load(std::memory_order_relaxed);
+		return std::max(n, 0);
+	}
+
+	// copies chunks of a frozen table until none are left to claim; the caller must hold a ReadGuard
+	static void help(Transfer *tr) {
+		for (int c; (c = tr->nextChunk.fetch_add(1)) < tr->chunks; ) {
+			int first = c * TRANSFER_CHUNK, last = std::min(first + TRANSFER_CHUNK, tr->from->capacity);
+			for (int i = first; i < last; ++i)
+				for (Node *p = tr->from->buckets[i].load(std::memory_order_acquire); p; p = p->next.load(std::memory_order_acquire)) {
+					std::atomic<Node*> &head = tr->to->buckets[bucketIndex(p->hashCode, tr->to->capacity)];
+					Node *q = new Node(p->hashCode, p->key, p->value, head.load(std::memory_order_relaxed));
+					Node *expected = q->next.load(std::memory_order_relaxed);
+					while (!head.compare_exchange_weak(expected, q, std::memory_order_release, std::memory_order_relaxed))
+						q->next.store(expected, std::memory_order_relaxed);
+				}
+			tr->chunksDone.fetch_add(1);
+		}
+	}
+
+	// t may already be freed: it is only compared with the current table until all stripes are held
+	void resize(Table *t) {
+		lockAll();
+		Table *cur = table.load();
+		if (cur != t || countEntries() <= cur->capacity * 0.50 || cur->hashModPtr + 1 >= TABLE_COUNT) {
+			unlockAll();
+			return;
+		}
+		Transfer *tr = new Transfer(cur, new Table(cur->hashModPtr + 1));
+		{
+			ReadGuard guard(*this);
+			transfer.store(tr);
+			help(tr);
+		}
+		while (tr->chunksDone.load() < tr->chunks)
+			std::this_thread::yield();
+		table.store(tr->to);
+		transfer.store(NULL);
+		unlockAll();
+		retire(NULL, cur, tr);
+	}
+
+	// locks the stripe of key's bucket in the current table, helping a running resize first;
+	// the returned table stays current for as long as the lock is held
+	Table* lockBucket(int code, std::unique_lock<std::mutex> &lock) {
+		for (;;) {
+			Table *t;
+			int capacity;
+			{
+				ReadGuard guard(*this);
+				Transfer *tr = transfer.load();
+				if (tr) help(tr);
+				t = table.load();
+				capacity = t->capacity;
+			}
+			lock = std::unique_lock<std::mutex>(stripeOf(bucketIndex(code, capacity)));
+			Table *cur = table.load();
+			if (cur == t && cur->capacity == capacity)
+				return cur;
+			lock.unlock();
+		}
+	}
+
+public:
+	ConcurrentHashMap():
+		getHashCode(), table(new Table(0)), transfer(NULL), epoch(0) {
+		for (int i = 0; i < THREAD_SLOTS; ++i) {
+			slots[i].active[0].store(0);
+			slots[i].active[1].store(0);
+			slots[i].sizeDelta.store(0);
+			retired[i].nodes = NULL;
+			retired[i].tables = NULL;
+			retired[i].transfers = NULL;
+			retired[i].pending = 0;
+		}
+	}
+
+	~ConcurrentHashMap() {
+		for (int i = 0; i < THREAD_SLOTS; ++i) {
+			freeRetired(retired[i].nodes, 0, true);
+			freeRetired(retired[i].tables, 0, true);
+			freeRetired(retired[i].transfers, 0, true);
+		}
+		delete table.load();
+	}
+
+	void clear() {
+		lockAll();
+		Table *t = table.load();
+		table.store(new Table(0));
+		for (int i = 0; i < THREAD_SLOTS; ++i)
+			slots[i].sizeDelta.store(0, std::memory_order_relaxed);
+		unlockAll();
+		retire(NULL, t, NULL);
+	}
+
+	bool containsKey(const K &key) const {
+		int code = getHashCode.hashCode(key);
+		ReadGuard guard(*this);
+		Table *t = table.load(std::memory_order_acquire);
+		for (Node *p = t->buckets[bucketIndex(code, t->capacity)].load(std::memory_order_acquire); p; p = p->next.load(std::memory_order_acquire))
+			if (p->hashCode == code && p->key == key)
+				return true;
+		return false;
+	}
+
+	/**
+	 * Copies the value mapped to key into value; returns false if key is absent.
+	 */
+	bool tryGet(const K &key, V &value) const {
+		int code = getHashCode.hashCode(key);
+		ReadGuard guard(*this);
+		Table *t = table.load(std::memory_order_acquire);
+		for (Node *p = t->buckets[bucketIndex(code, t->capacity)].load(std::memory_order_acquire); p; p = p->next.load(std::memory_order_acquire))
+			if (p->hashCode == code && p->key == key) {
+				value = p->value;
+				return true;
+			}
+		return false;
+	}
+
+	V get(const K &key) const {
+		int code = getHashCode.hashCode(key);
+		ReadGuard guard(*this);
+		Table *t = table.load(std::memory_order_acquire);
+		for (Node *p = t->buckets[bucketIndex(code, t->capacity)].load(std::memory_order_acquire); p; p = p->next.load(std::memory_order_acquire))
+			if (p->hashCode == code && p->key == key)
+				return p->value;
+		throw ElementNotExist("");
+	}
+
+	bool isEmpty() const {
+		return countEntries() == 0;
+	}
+
+	void put(const K &key, const V &value) {
+		int code = getHashCode.hashCode(key);
+		Node *replaced = NULL;
+		std::unique_lock<std::mutex> lock;
+		Table *t = lockBucket(code, lock);
+		std::atomic<Node*> *link = &t->buckets[bucketIndex(code, t->capacity)];
+		for (Node *p = link->load(std::memory_order_relaxed); p; link = &p->next, p = p->next.load(std::memory_order_relaxed))
+			if (p->hashCode == code && p->key == key) {
+				replaced = p;
+				break;
+			}
+		bool grow = false;
+		if (replaced)
+			link->store(new Node(code, key, value, replaced->next.load(std::memory_order_relaxed)), std::memory_order_release);
+		else {
+			link->store(new Node(code, key, value, NULL), std::memory_order_release);
+			// summing the slots on every add would make them shared again, so a large table
+			// checks its load every SIZE_CHECK adds per slot and overshoots 0.5 by a little
+			int delta = slots[threadSlot()].sizeDelta.fetch_add(1, std::memory_order_relaxed) + 1;
+			if (t->capacity < SIZE_CHECK * THREAD_SLOTS * 8 || delta % SIZE_CHECK == 0)
+				grow = countEntries() > t->capacity * 0.50;
+		}
+		lock.unlock();
+		if (replaced)
+			retire(replaced, NULL, NULL);
+		else if (grow)
+			resize(t);
+	}
+
+	void remove(const K &key) {
+		int code = getHashCode.hashCode(key);
+		std::unique_lock<std::mutex> lock;
+		Table *t = lockBucket(code, lock);
+		std::atomic<Node*> *link = &t->buckets[bucketIndex(code, t->capacity)];
+		for (Node *p = link->load(std::memory_order_relaxed); p; link = &p->next, p = p->next.load(std::memory_order_relaxed))
+			if (p->hashCode == code && p->key == key) {
+				link->store(p->next.load(std::memory_order_relaxed), std::memory_order_release);
+				slots[threadSlot()].sizeDelta.fetch_sub(1, std::memory_order_relaxed);
+				lock.unlock();
+				retire(p, NULL, NULL);
+				return;
+			}
+		throw ElementNotExist("");
+	}
+
+	int size() const {
+		return countEntries();
+	}
+};
+
+template <class K, class V, class H>
+const int ConcurrentHashMap<K, V, H>::STRIPES;
+
+template <class K, class V, class H>
+const int ConcurrentHashMap<K, V, H>::THREAD_SLOTS;
+
+template <class K, class V, class H>
+const int ConcurrentHashMap<K, V, H>::TRANSFER_CHUNK;
+
+template <class K, class V, class H>
+const int ConcurrentHashMap<K, V, H>::RECLAIM_THRESHOLD;
+
+template <class K, class V, class H>
+const int ConcurrentHashMap<K, V, H>::SIZE_CHECK;
+
+#endif
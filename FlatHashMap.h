@@ -0,0 +1,342 @@
+/** @file */
+
+#ifndef __FLATHASHMAP_H
+#define __FLATHASHMAP_H
+
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "ElementNotExist.h"
+#include "Hash.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * Open-addressing hash map with the same interface as HashMap<K, V, H>.
+ *
+ * Keys and values live inline in one slot array. A parallel array holds one
+ * control byte per slot: EMPTY, DELETED, or the low 7 bits of the hash of the
+ * key stored there. Lookups compare 16 control bytes at a time and only touch
+ * the slots whose byte matches, so a hit usually costs a single slot access.
+ */
+template<class K, class V, class H = DefaultHash<K> >
+class FlatHashMap {
+private:
+	typedef signed char Ctrl;
+
+	static const Ctrl EMPTY = -128;
+	static const Ctrl DELETED = -2;
+	static const int GROUP_WIDTH = 16;
+	static const int MIN_CAPACITY = 16;
+
+	struct Slot {
+		K key;
+		V value;
+		Slot(const K &key, const V &value): key(key), value(value) {
+		}
+	};
+
+	// bit i is set when control byte i of the group satisfies the query
+	class Group {
+	private:
+		const Ctrl *ctrl;
+	public:
+		explicit Group(const Ctrl *ctrl): ctrl(ctrl) {
+		}
+
+#if defined(__SSE2__)
+		unsigned match(Ctrl h2) const {
+			__m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+			return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(h2)));
+		}
+
+		unsigned matchEmpty() const {
+			return match(EMPTY);
+		}
+
+		unsigned matchEmptyOrDeleted() const { // EMPTY and DELETED are the only bytes below -1
+			__m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+			return (unsigned)_mm_movemask_epi8(_mm_cmplt_epi8(g, _mm_set1_epi8(-1)));
+		}
+#else
+		unsigned match(Ctrl h2) const {
+			unsigned mask = 0;
+			for (int i = 0; i < GROUP_WIDTH; ++i)
+				if (ctrl[i] == h2)
+					mask |= 1u << i;
+			return mask;
+		}
+
+		unsigned matchEmpty() const {
+			return match(EMPTY);
+		}
+
+		unsigned matchEmptyOrDeleted() const {
+			unsigned mask = 0;
+			for (int i = 0; i < GROUP_WIDTH; ++i)
+				if (ctrl[i] < -1)
+					mask |= 1u << i;
+			return mask;
+		}
+#endif
+	};
+
+	H getHashCode;
+
+	int _size;
+	int capacity; // power of two
+	int growthLeft; // insertions into EMPTY slots before the next rehash
+	Ctrl *ctrl; // capacity + GROUP_WIDTH bytes: the last GROUP_WIDTH mirror the first
+	Slot *slots;
+
+	// spread hashCode() over 64 bits: probing uses the high bits, control bytes the low 7
+	unsigned long long spreadHash(const K &key) const {
+		return hashMix((unsigned)getHashCode.hashCode(key));
+	}
+
+	static Ctrl h2Of(unsigned long long hash) {
+		return (Ctrl)(hash & 0x7F);
+	}
+
+	static int maxLoad(int cap) {
+		return cap - cap / 8;
+	}
+
+	void setCtrl(int i, Ctrl c) {
+		ctrl[i] = c;
+		if (i < GROUP_WIDTH)
+			ctrl[capacity + i] = c;
+	}
+
+	void allocate(int cap) {
+		capacity = cap;
+		ctrl = new Ctrl[cap + GROUP_WIDTH];
+		std::memset(ctrl, EMPTY, cap + GROUP_WIDTH);
+		slots = static_cast<Slot*>(::operator new(sizeof(Slot) * cap));
+		growthLeft = maxLoad(cap);
+	}
+
+	void destroy() {
+		if (!std::is_trivially_destructible<Slot>::value)
+			for (int i = 0; i < capacity; ++i)
+				if (ctrl[i] >= 0)
+					slots[i].~Slot();
+		delete[] ctrl;
+		::operator delete(slots);
+		ctrl = NULL;
+		slots = NULL;
+		_size = 0;
+		capacity = 0;
+		growthLeft = 0;
+	}
+
+	int find(const K &key, unsigned long long hash) const {
+		int mask = capacity - 1, pos = (int)(hash >> 7) & mask;
+		Ctrl h2 = h2Of(hash);
+		for (int step = 0; ; ) {
+			Group g(ctrl + pos);
+			for (unsigned m = g.match(h2); m; m &= m - 1) {
+				int i = (pos + __builtin_ctz(m)) & mask;
+				if (slots[i].key == key)
+					return i;
+			}
+			if (g.matchEmpty())
+				return -1;
+			step += GROUP_WIDTH;
+			pos = (pos + step) & mask;
+		}
+	}
+
+	int findFree(unsigned long long hash) const {
+		int mask = capacity - 1, pos = (int)(hash >> 7) & mask;
+		for (int step = 0; ; ) {
+			unsigned m = Group(ctrl + pos).matchEmptyOrDeleted();
+			if (m)
+				return (pos + __builtin_ctz(m)) & mask;
+			step += GROUP_WIDTH;
+			pos = (pos + step) & mask;
+		}
+	}
+
+	// moves every entry into a fresh table of cap slots, dropping tombstones
+	void rehash(int cap) {
+		Ctrl *oldCtrl = ctrl;
+		Slot *oldSlots = slots;
+		int oldCapacity = capacity;
+		allocate(cap);
+		for (int i = 0; i < oldCapacity; ++i)
+			if (oldCtrl[i] >= 0) {
+				unsigned long long hash = spreadHash(oldSlots[i].key);
+				int j = findFree(hash);
+				setCtrl(j, h2Of(hash));
+				new (slots + j) Slot(std::move(oldSlots[i]));
+				oldSlots[i].~Slot();
+			}
+		growthLeft -= _size;
+		delete[] oldCtrl;
+		::operator delete(oldSlots);
+	}
+
+	void cloneTo(int &otherSize, int &otherCapacity, int &otherGrowthLeft, Ctrl *&otherCtrl, Slot *&otherSlots) const {
+		otherCtrl = new Ctrl[capacity + GROUP_WIDTH];
+		std::memcpy(otherCtrl, ctrl, capacity + GROUP_WIDTH);
+		otherSlots = static_cast<Slot*>(::operator new(sizeof(Slot) * capacity));
+		for (int i = 0; i < capacity; ++i)
+			if (ctrl[i] >= 0)
+				new (otherSlots + i) Slot(slots[i]);
+		otherSize = _size;
+		otherCapacity = capacity;
+		otherGrowthLeft = growthLeft;
+	}
+
+public:
+
+	class Entry {
+	private:
+		K key;
+		V value;
+
+	public:
+		Entry(const K &key, const V &value): key(key), value(value) {
+		}
+		const K& getKey() const {
+			return key;
+		}
+		const V& getValue() const {
+			return value;
+		}
+	};
+
+	class Iterator {
+	private:
+		const FlatHashMap<K, V, H> *from;
+		int pos; // next full slot, or capacity when exhausted
+
+		void skip() {
+			while (pos < from->capacity && from->ctrl[pos] < 0)
+				++pos;
+		}
+
+	public:
+		Iterator(): from(NULL), pos(0) {
+		}
+
+		Iterator(const FlatHashMap<K, V, H> &fmap): from(&fmap), pos(0) {
+			skip();
+		}
+
+		bool hasNext() const {
+			return from != NULL && pos < from->capacity;
+		}
+
+		Entry next() {
+			if (!hasNext())
+				throw ElementNotExist("");
+			const Slot &s = from->slots[pos++];
+			skip();
+			return Entry(s.key, s.value);
+		}
+	};
+
+	FlatHashMap(): getHashCode(), _size(0), capacity(0), growthLeft(0), ctrl(NULL), slots(NULL) {
+		allocate(MIN_CAPACITY);
+	}
+
+	FlatHashMap(const FlatHashMap<K, V, H> &other): getHashCode(other.getHashCode), _size(0), capacity(0), growthLeft(0), ctrl(NULL), slots(NULL) {
+		other.cloneTo(_size, capacity, growthLeft, ctrl, slots);
+	}
+
+	~FlatHashMap() {
+		destroy();
+	}
+
+	FlatHashMap<K, V, H>& operator = (const FlatHashMap<K, V, H> &other) {
+		if (this != &other) {
+			destroy();
+			getHashCode = other.getHashCode;
+			other.cloneTo(_size, capacity, growthLeft, ctrl, slots);
+		}
+		return *this;
+	}
+
+	Iterator iterator() const {
+		return Iterator(*this);
+	}
+
+	void clear() {
+		destroy();
+		allocate(MIN_CAPACITY);
+	}
+
+	bool containsKey(const K &key) const {
+		return find(key, spreadHash(key)) != -1;
+	}
+
+	bool containsValue(const V &value) const {
+		for (int i = 0; i < capacity; ++i)
+			if (ctrl[i] >= 0 && slots[i].value == value)
+				return true;
+		return false;
+	}
+
+	const V& get(const K &key) const {
+		int i = find(key, spreadHash(key));
+		if (i == -1)
+			throw ElementNotExist("");
+		return slots[i].value;
+	}
+
+	bool isEmpty() const {
+		return _size == 0;
+	}
+
+	void put(const K &key, const V &value) {
+		unsigned long long hash = spreadHash(key);
+		int i = find(key, hash);
+		if (i != -1) {
+			slots[i].value = value;
+			return;
+		}
+		i = findFree(hash);
+		if (growthLeft == 0 && ctrl[i] == EMPTY) {
+			// grow only when live entries fill the table; otherwise just sweep tombstones
+			rehash(_size >= maxLoad(capacity) / 2 ? capacity << 1 : capacity);
+			i = findFree(hash);
+		}
+		new (slots + i) Slot(key, value);
+		if (ctrl[i] == EMPTY)
+			--growthLeft;
+		setCtrl(i, h2Of(hash));
+		++_size;
+	}
+
+	void remove(const K &key) {
+		int i = find(key, spreadHash(key));
+		if (i == -1)
+			throw ElementNotExist("");
+		slots[i].~Slot();
+		setCtrl(i, DELETED);
+		--_size;
+	}
+
+	int size() const {
+		return _size;
+	}
+};
+
+template<class K, class V, class H>
+const typename FlatHashMap<K, V, H>::Ctrl FlatHashMap<K, V, H>::EMPTY;
+
+template<class K, class V, class H>
+const typename FlatHashMap<K, V, H>::Ctrl FlatHashMap<K, V, H>::DELETED;
+
+template<class K, class V, class H>
+const int FlatHashMap<K, V, H>::GROUP_WIDTH;
+
+template<class K, class V, class H>
+const int FlatHashMap<K, V, H>::MIN_CAPACITY;
+
+#endif
@@ -0,0 +1,169 @@
+/** @file Hash.h
+ * Default hashers for HashMap and its variants.
+ *
+ * DefaultHash<K>::hashCode(key) returns an int, as every H in this project
+ * does. Integers, enums and floating-point numbers go through a 64-bit
+ * finalizer so that sequential or strided keys do not collide modulo the
+ * table size. Strings and raw bytes use hashBytes, a wyhash-style function
+ * that reads eight bytes at a time and runs three independent multiply
+ * lanes for keys longer than 48 bytes.
+ */
+
+#ifndef __HASH_H
+#define __HASH_H
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+namespace hash_detail {
+
+	const unsigned long long P0 = 0xa0761d6478bd642fULL;
+	const unsigned long long P1 = 0xe7037ed1a0b428dbULL;
+	const unsigned long long P2 = 0x8ebc6af09c88c6e3ULL;
+	const unsigned long long P3 = 0x589965cc75374cc3ULL;
+
+	// full 64x64 -> 128 bit product, returned as (low, high)
+	inline void multiply(unsigned long long a, unsigned long long b, unsigned long long &lo, unsigned long long &hi) {
+#if defined(__SIZEOF_INT128__)
+		unsigned __int128 r = (unsigned __int128)a * b;
+		lo = (unsigned long long)r;
+		hi = (unsigned long long)(r >> 64);
+#else
+		unsigned long long ha = a >> 32, hb = b >> 32, la = (unsigned)a, lb = (unsigned)b;
+		unsigned long long rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+		unsigned long long t = rl + (rm0 << 32), c = t < rl;
+		lo = t + (rm1 << 32);
+		c += lo < t;
+		hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+	}
+
+	inline unsigned long long mix(unsigned long long a, unsigned long long b) {
+		unsigned long long lo, hi;
+		multiply(a, b, lo, hi);
+		return lo ^ hi;
+	}
+
+	inline unsigned long long read8(const unsigned char *p) {
+		unsigned long long v;
+		std::memcpy(&v, p, 8);
+		return v;
+	}
+
+	inline unsigned long long read4(const unsigned char *p) {
+		unsigned v;
+		std::memcpy(&v, p, 4);
+		return v;
+	}
+
+	inline unsigned long long read3(const unsigned char *p, size_t k) {
+		return ((unsigned long long)p[0] << 16) | ((unsigned long long)p[k >> 1] << 8) | p[k - 1];
+	}
+
+}
+
+/**
+ * 64-bit hash of len bytes at data.
+ */
+inline unsigned long long hashBytes(const void *data, size_t len, unsigned long long seed = 0) {
+	using namespace hash_detail;
+	const unsigned char *p = static_cast<const unsigned char*>(data);
+	unsigned long long a, b;
+	seed ^= mix(seed ^ P0, P1);
+	if (len <= 16) {
+		if (len >= 4) {
+			size_t mid = (len >> 3) << 2;
+			a = (read4(p) << 32) | read4(p + mid);
+			b = (read4(p + len - 4) << 32) | read4(p + len - 4 - mid);
+		}
+		else if (len > 0) {
+			a = read3(p, len);
+			b = 0;
+		}
+		else
+			a = b = 0;
+	}
+	else {
+		size_t i = len;
+		if (i > 48) {
+			unsigned long long see1 = seed, see2 = seed;
+			do {
+				seed = mix(read8(p) ^ P1, read8(p + 8) ^ seed);
+				see1 = mix(read8(p + 16) ^ P2, read8(p + 24) ^ see1);
+				see2 = mix(read8(p + 32) ^ P3, read8(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while (i > 48);
+			seed ^= see1 ^ see2;
+		}
+		while (i > 16) {
+			seed = mix(read8(p) ^ P1, read8(p + 8) ^ seed);
+			p += 16;
+			i -= 16;
+		}
+		a = read8(p + i - 16);
+		b = read8(p + i - 8);
+	}
+	multiply(a ^ P1, b ^ seed, a, b);
+	return mix(a ^ P0 ^ len, b ^ P1);
+}
+
+/**
+ * Finalizer that spreads every input bit over the whole 64-bit result.
+ */
+inline unsigned long long hashMix(unsigned long long x) {
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	return x ^ (x >> 33);
+}
+
+inline int hashFold(unsigned long long h) {
+	return (int)(unsigned)(h ^ (h >> 32));
+}
+
+template <class K, bool NUMERIC = std::is_integral<K>::value || std::is_enum<K>::value>
+class DefaultHash;
+
+template <class K>
+class DefaultHash<K, true> {
+public:
+	int hashCode(const K &key) const {
+		return hashFold(hashMix((unsigned long long)key));
+	}
+};
+
+template <>
+class DefaultHash<float, false> {
+public:
+	int hashCode(const float &key) const {
+		float k = key == 0 ? 0.0f : key; // -0.0f == 0.0f must hash alike
+		unsigned bits;
+		std::memcpy(&bits, &k, sizeof(bits));
+		return hashFold(hashMix(bits));
+	}
+};
+
+template <>
+class DefaultHash<double, false> {
+public:
+	int hashCode(const double &key) const {
+		double k = key == 0 ? 0.0 : key;
+		unsigned long long bits;
+		std::memcpy(&bits, &k, sizeof(bits));
+		return hashFold(hashMix(bits));
+	}
+};
+
+template <>
+class DefaultHash<std::string, false> {
+public:
+	int hashCode(const std::string &key) const {
+		return hashFold(hashBytes(key.data(), key.size()));
+	}
+};
+
+#endif /* __HASH_H */
@@ -3,14 +3,25 @@
 #ifndef __HASHMAP_H
 #define __HASHMAP_H
 
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+#include "ChainedHashTable.h"
 #include "ElementNotExist.h"
+#include "HashMapSnapshot.h"
 
-template<class K, class V, class H>
-class HashMap {
-private:
+template<class K, class V, class H> class MappedHashMap;
+
+template<class K, class V, class H = DefaultHash<K> >
+class HashMap: protected ChainedHashTable<K, V, H> {
+	template<class, class, class> friend class MappedHashMap; // copyTo sizes through growTo
+
+protected:
+	typedef ChainedHashTable<K, V, H> Base;
+	typedef typename Base::List List;
 	typedef K* Kp;
 	typedef V* Vp;
-	H getHashCode;
 
 public:
 
@@ -49,99 +60,112 @@ public:
 			if (value) delete value;
 		}
 	};
-	
-private:
-	class Node {
-	public:
-		Kp key;
-		Vp value;
-		int hashCode;
-		Node *next, *l, *r;
-		Node(): key(NULL), value(NULL), hashCode(0), next(NULL), l(this), r(this) {
-		}
 
-		Node(const K &key, const V &value):
-			key(new K(key)), value(new V(value)), hashCode(getHashCode.hashCode(key)), next(NULL), l(NULL), r(NULL) {
-		}
+	/**
+	 * Non-owning view of an entry, valid until that entry is removed.
+	 */
+	class EntryRef {
+	private:
+		const K *key;
+		const V *value;
 
-		Node(const K &key, const V &value, const int &hashCode):
-			key(new K(key)), value(new V(value)), hashCode(hashCode), next(NULL), l(NULL), r(NULL) {
+	public:
+		EntryRef(const K &key, const V &value): key(&key), value(&value) {
 		}
-
-		~Node() {
-			if (key) {
-				delete key;
-			}
-			if (value) {
-				delete value;
-			}
+		const K& getKey() const {
+			return *key;
+		}
+		const V& getValue() const {
+			return *value;
 		}
 	};
 
-private:
-	typedef Node *List;
+	/**
+	 * Like EntryRef, but the value may be modified in place.
+	 */
+	class MutableEntryRef {
+	private:
+		const K *key;
+		V *value;
 
-	const static int TABLE_SIZE[];
-	
-	int _size;
-	int hashModPtr, capacity;
-	List header;
-	List *pool;
-
-	void ensureCapacity(int cap) {
-		if (capacity * 0.50 < cap) {
-			capacity = TABLE_SIZE[++hashModPtr];
-			List* newPool = new List[capacity];
-			for (int i = 0; i < capacity; ++i) newPool[i] = NULL;
-
-			int cnt = 0;
-			for (List p = header->r; p != header; p = p->r) {
-				int h = p->hashCode % capacity;
-				if (h < 0) h += capacity;
-				p->next = newPool[h];
-				newPool[h] = p;
-				++cnt;
-			}
-			if (pool) delete[] pool;
-			pool = newPool;
+	public:
+		MutableEntryRef(const K &key, V &value): key(&key), value(&value) {
+		}
+		const K& getKey() const {
+			return *key;
 		}
+		V& getValue() const {
+			return *value;
+		}
+		void setValue(const V &v) const {
+			*value = v;
+		}
+	};
+	
+protected:
+	using Base::getHashCode;
+	using Base::_size;
+	using Base::capacity;
+	using Base::header;
+	using Base::bucketIndex;
+	using Base::bucket;
+	using Base::findIn;
+	using Base::findNode;
+	using Base::linkNode;
+	using Base::link;
+	using Base::migrate;
+	using Base::growTo;
+	using Base::ensureCapacity;
+	using Base::shrinkIfSparse;
+	using Base::deleteNode;
+	using Base::REHASH_STEP;
+
+	const static int PREFETCH_BATCH = 16; // keys in flight per stage of getMany/containsMany
+
+	static void prefetch(const void *p) {
+#if defined(__GNUC__)
+		__builtin_prefetch(p);
+#else
+		(void)p;
+#endif
 	}
 
-	void cloneTo(int &otherSize, int &otherHashModPtr, int &otherCapacity, List &otherHeader, List* &otherPool) const {
-		otherSize = _size;
-		otherHashModPtr = hashModPtr;
-		otherCapacity = capacity;
-		otherHeader = new Node();
-		otherPool = new List[capacity];
-		for (int i = 0; i < capacity; ++i) otherPool[i] = NULL;
-		for (List p = header->r; p != header; p = p->r) {
-			List element = new Node();
-			element->key = new K(*p->key);
-			element->value = new V(*p->value);
-			element->hashCode = p->hashCode;
-			List l = element->l = otherHeader->l, r = element->r = otherHeader;
-			l->r = r->l = element;
-			int h = element->hashCode % capacity;
-			element->next = otherPool[h];
-			otherPool[h] = element;
+	// group prefetching: every stage of a batch is issued before the next stage
+	// touches its memory, so the misses of up to PREFETCH_BATCH keys overlap
+	template <class Visit>
+	void probeMany(const K *keys, int n, Visit visit) const {
+		int codes[PREFETCH_BATCH];
+		List *heads[PREFETCH_BATCH];
+		List firsts[PREFETCH_BATCH];
+		for (int base = 0; base < n; base += PREFETCH_BATCH) {
+			int m = n - base < PREFETCH_BATCH ? n - base : PREFETCH_BATCH;
+			for (int i = 0; i < m; ++i) {
+				codes[i] = getHashCode.hashCode(keys[base + i]);
+				heads[i] = &bucket(codes[i]);
+				prefetch(heads[i]);
+			}
+			for (int i = 0; i < m; ++i) {
+				firsts[i] = *heads[i];
+				if (firsts[i]) prefetch(firsts[i]);
+			}
+			for (int i = 0; i < m; ++i)
+				visit(base + i, findIn(firsts[i], keys[base + i], codes[i]));
 		}
 	}
 
-	void destroy() { // everything but header is cleared
-		_size = 0;
-		hashModPtr = 0;
-		capacity = 0;
-		if (pool) {
-			delete[] pool;
-			pool = NULL;
+	struct ValueVisitor {
+		const V **out;
+		void operator () (int i, List p) const {
+			out[i] = p ? &p->value() : NULL;
 		}
+	};
 
-		for (List p = header->r, next; p != header; p = next) {
-			next = p->r;
-			delete p;
+	struct ContainsVisitor {
+		bool *out;
+		void operator () (int i, List p) const {
+			out[i] = p != NULL;
 		}
-		header->l = header->r = header;
-	}
+	};
 
 public:
 	class Iterator {
@@ -163,103 +187,249 @@ public:
 			if (!hasNext())
 				throw ElementNotExist("");
 			p = p->r;
-			return Entry(*p->key, *p->value);
+			return Entry(p->key(), p->value());
+		}
+
+		/**
+		 * Like next(), but returns a view of the entry instead of copying it.
+		 */
+		EntryRef nextRef() {
+			if (!hasNext())
+				throw ElementNotExist("");
+			p = p->r;
+			return EntryRef(p->key(), p->value());
 		}
 	};
 
-	HashMap(): 
-		getHashCode(), _size(0), hashModPtr(0), capacity(TABLE_SIZE[0]), 
-		header(new Node()),
-		pool(new List[capacity]) {
-		for (int i = 0; i < capacity; ++i)
-			pool[i] = NULL;
-	}
+	class MutableIterator {
+	private:
+		List header, p;
+	public:
 
-	HashMap(const HashMap<K, V, H> &other): getHashCode(other.getHashCode), _size(0), hashModPtr(0), capacity(0), header(NULL), pool(NULL) {
-		other.cloneTo(_size, hashModPtr, capacity, header, pool);
-	}
+		MutableIterator(): header(NULL), p(NULL) {
+		}
 
-	~HashMap() {
-		destroy();
-		delete header;
-		header = NULL;
-	}
+		MutableIterator(HashMap<K, V, H> &hmap): header(hmap.header), p(header) {
+		}
+
+		bool hasNext() const {
+			return header != NULL && p != NULL && p->r != header;
+		}
 
-	HashMap<K, V, H>& operator = (const HashMap<K, V, H> &other) {
-		if (this != &other) {
-			destroy();
-			delete header;
-			header = NULL;
-			getHashCode = other.getHashCode;
-			other.cloneTo(_size, hashModPtr, capacity, header, pool);
+		MutableEntryRef next() {
+			if (!hasNext())
+				throw ElementNotExist("");
+			p = p->r;
+			return MutableEntryRef(p->key(), p->value());
 		}
-		return *this;
+	};
+
+	typedef typename Base::MemoryUsage MemoryUsage;
+
+	using Base::clear;
+	using Base::compact;
+	using Base::hashOf;
+	using Base::isEmpty;
+	using Base::memoryUsage;
+	using Base::reserve;
+	using Base::setAutoShrink;
+	using Base::setIncrementalRehash;
+	using Base::size;
+
+	HashMap() {
+	}
+
+	/**
+	 * Creates a map whose bucket array already fits expectedSize entries; like
+	 * reserve(), auto-shrinking never goes below that size.
+	 */
+	explicit HashMap(int expectedSize): Base(expectedSize) {
 	}
 
 	Iterator iterator() const {
 		return Iterator(*this);
 	}
 
-	void clear() {
-		destroy();
-		capacity = TABLE_SIZE[0];
-		pool = new List[capacity];
-		for (int i = 0; i < capacity; ++i) pool[i] = NULL;
+	/**
+	 * Iterates in the same order as iterator(), allowing values to be updated in place.
+	 */
+	MutableIterator mutableIterator() {
+		return MutableIterator(*this);
 	}
-	
+
 	bool containsKey(const K &key) const {
-		int code = getHashCode.hashCode(key), h = code % capacity;
-		if (h < 0) h += capacity;
-		for (List p = pool[h]; p; p = p->next)
-			if (p->hashCode == code && *p->key == key)
-				return true;
-		return false;
+		return containsKey(key, getHashCode.hashCode(key));
+	}
+
+	bool containsKey(const K &key, int code) const {
+		return findNode(key, code) != NULL;
 	}
 
 	bool containsValue(const V &value) const {
 		for (List p = header->r; p != header; p = p->r)
-			if (*p->value == value)
+			if (p->value() == value)
 				return true;
 		return false;
 	}
 
 	const V& get(const K &key) const {
-		int code = getHashCode.hashCode(key), h = code % capacity;
-		if (h < 0) h += capacity;
-		for (List p = pool[h]; p; p = p->next)
-			if (p->hashCode == code && *p->key == key)
-				return *p->value;
-		throw ElementNotExist("");
-		return *header->value;
+		return get(key, getHashCode.hashCode(key));
 	}
-	
-	bool isEmpty() const {
-		return _size == 0;
+
+	const V& get(const K &key, int code) const {
+		List p = findNode(key, code);
+		if (p == NULL)
+			throw ElementNotExist("");
+		return p->value();
 	}
 	
+	/**
+	 * Looks up keys[0..n) as one batch: out[i] points to the value of keys[i],
+	 * or is NULL if it is absent. Bucket heads and nodes are prefetched a batch
+	 * at a time, so large tables pay roughly one memory latency per batch
+	 * instead of several per key.
+	 */
+	void getMany(const K *keys, int n, const V **out) const {
+		ValueVisitor visit = { out };
+		probeMany(keys, n, visit);
+	}
+
+	/**
+	 * Batched containsKey: out[i] tells whether keys[i] is present.
+	 */
+	void containsMany(const K *keys, int n, bool *out) const {
+		ContainsVisitor visit = { out };
+		probeMany(keys, n, visit);
+	}
+
+	/**
+	 * Puts every (first, second) pair of the forward range [first, last).
+	 * The table is sized once up front, so the loop itself never rehashes.
+	 */
+	template <class ForwardIterator>
+	void putAll(ForwardIterator first, ForwardIterator last) {
+		growTo(_size + (int)std::distance(first, last));
+		for (; first != last; ++first) {
+			int code = getHashCode.hashCode(first->first);
+			List &head = bucket(code);
+			List p = findIn(head, first->first, code);
+			if (p)
+				p->value() = first->second;
+			else
+				linkNode(head, first->first, first->second, code);
+		}
+		ensureCapacity(_size);
+	}
+
+	/**
+	 * Puts every entry of other, reusing its cached hash codes.
+	 */
+	void putAll(const HashMap<K, V, H> &other) {
+		if (&other == this) return;
+		growTo(_size + other._size);
+		for (List q = other.header->r; q != other.header; q = q->r) {
+			List &head = bucket(q->hashCode);
+			List p = findIn(head, q->key(), q->hashCode);
+			if (p)
+				p->value() = q->value();
+			else
+				linkNode(head, q->key(), q->value(), q->hashCode);
+		}
+		ensureCapacity(_size);
+	}
+
 	void put(const K &key, const V &value) {
-		int code = getHashCode.hashCode(key), h = code % capacity;
-		if (h < 0) h += capacity;
-		for (List p = pool[h]; p; p = p->next)
-			if (code == p->hashCode && *p->key == key) {
-				delete p->value;
-				p->value = new V(value);
-				return;
-			}
-		List p = new Node(key, value, code), l = p->l = header->l, r = p->r = header;
-		l->r = r->l = p;
-		p->next = pool[h];
-		pool[h] = p;
-		ensureCapacity(++_size);
+		put(key, value, getHashCode.hashCode(key));
+	}
+
+	void put(const K &key, const V &value, int code) {
+		migrate(REHASH_STEP);
+		List &head = bucket(code);
+		List p = findIn(head, key, code);
+		if (p)
+			p->value() = value;
+		else
+			link(head, key, value, code);
+	}
+
+	/**
+	 * Returns the value mapped to key, first mapping it to V() if key is absent.
+	 * Hashes the key and walks its chain once.
+	 */
+	V& getOrInsert(const K &key) {
+		migrate(REHASH_STEP);
+		int code = getHashCode.hashCode(key);
+		List &head = bucket(code);
+		List p = findIn(head, key, code);
+		if (p == NULL)
+			p = link(head, key, V(), code);
+		return p->value();
+	}
+
+	/**
+	 * Returns the value mapped to key; if key is absent, maps it to fn(key) first.
+	 * Nothing is inserted if fn throws.
+	 */
+	template <class F>
+	V& computeIfAbsent(const K &key, F fn) {
+		migrate(REHASH_STEP);
+		int code = getHashCode.hashCode(key);
+		List &head = bucket(code);
+		List p = findIn(head, key, code);
+		if (p == NULL)
+			p = link(head, key, fn(key), code);
+		return p->value();
+	}
+
+	/**
+	 * Maps key to value if it is absent, and to fn(current, value) otherwise.
+	 * Returns the resulting value.
+	 */
+	template <class F>
+	V& merge(const K &key, const V &value, F fn) {
+		migrate(REHASH_STEP);
+		int code = getHashCode.hashCode(key);
+		List &head = bucket(code);
+		List p = findIn(head, key, code);
+		if (p == NULL)
+			p = link(head, key, value, code);
+		else
+			p->value() = fn(p->value(), value);
+		return p->value();
+	}
+
+	/**
+	 * Returns a pointer to the value mapped to key, or NULL if key is absent.
+	 */
+	const V* tryGet(const K &key) const {
+		return tryGet(key, getHashCode.hashCode(key));
+	}
+
+	V* tryGet(const K &key) {
+		return tryGet(key, getHashCode.hashCode(key));
+	}
+
+	const V* tryGet(const K &key, int code) const {
+		List p = findNode(key, code);
+		return p ? &p->value() : NULL;
+	}
+
+	V* tryGet(const K &key, int code) {
+		List p = findNode(key, code);
+		return p ? &p->value() : NULL;
 	}
 	
 	void remove(const K &key) {
-		int code = getHashCode.hashCode(key), h = code % capacity;
-		if (h < 0) h += capacity;
-		for (List p = pool[h], last = NULL; p; last = p, p = p->next)
-			if (p->hashCode == code && *p->key == key) {
+		remove(key, getHashCode.hashCode(key));
+	}
+
+	void remove(const K &key, int code) {
+		migrate(REHASH_STEP);
+		List &head = bucket(code);
+		for (List p = head, last = NULL; p; last = p, p = p->next)
+			if (p->hashCode == code && p->key() == key) {
 				if (last == NULL) {
-					pool[h] = pool[h]->next;
+					head = head->next;
 				}
 				else {
 					last->next = p->next;
@@ -267,31 +437,66 @@ public:
 				List l = p->l, r = p->r;
 				l->r = r;
 				r->l = l;
-				delete p;
+				deleteNode(p);
 				--_size;
+				shrinkIfSparse();
 				return;
 			}
 		throw ElementNotExist("");
 	}
 	
-	int size() const {
-		return _size;
+	/**
+	 * Writes the map to path in the HashMapSnapshot.h layout, to be opened
+	 * later with MappedHashMap<K, V, H>. K and V must be trivially copyable.
+	 * Returns false if the file cannot be written.
+	 */
+	bool saveSnapshot(const char *path) const {
+		static_assert(std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value,
+				"snapshots store keys and values as raw bytes");
+		typedef HashMapSnapshotEntry<K, V> SnapshotEntry;
+
+		HashMapSnapshotHeader head;
+		std::memset(&head, 0, sizeof(head));
+		std::memcpy(head.magic, SNAPSHOT_MAGIC, sizeof(head.magic));
+		head.keySize = sizeof(K);
+		head.valueSize = sizeof(V);
+		head.entrySize = sizeof(SnapshotEntry);
+		head.capacity = capacity;
+		head.size = _size;
+		head.entriesOffset = snapshotAlign(sizeof(head));
+		head.bucketsOffset = snapshotAlign(head.entriesOffset + (unsigned long long)_size * sizeof(SnapshotEntry));
+		head.fileSize = head.bucketsOffset + (unsigned long long)capacity * sizeof(int);
+
+		std::FILE *file = std::fopen(path, "wb");
+		if (file == NULL)
+			return false;
+		int *buckets = new int[capacity];
+		for (int i = 0; i < capacity; ++i) buckets[i] = -1;
+
+		bool ok = std::fwrite(&head, sizeof(head), 1, file) == 1
+				&& snapshotPad(file, head.entriesOffset - sizeof(head));
+		typename std::aligned_storage<sizeof(SnapshotEntry), std::alignment_of<SnapshotEntry>::value>::type buffer;
+		SnapshotEntry *e = reinterpret_cast<SnapshotEntry*>(&buffer);
+		int index = 0;
+		for (List p = header->r; ok && p != header; p = p->r, ++index) {
+			int h = bucketIndex(p->hashCode, capacity);
+			std::memset(&buffer, 0, sizeof(buffer));
+			e->hashCode = p->hashCode;
+			e->next = buckets[h];
+			std::memcpy(static_cast<void*>(&e->key), &p->key(), sizeof(K));
+			std::memcpy(static_cast<void*>(&e->value), &p->value(), sizeof(V));
+			buckets[h] = index;
+			ok = std::fwrite(e, sizeof(SnapshotEntry), 1, file) == 1;
+		}
+		unsigned long long written = head.entriesOffset + (unsigned long long)_size * sizeof(SnapshotEntry);
+		ok = ok && snapshotPad(file, head.bucketsOffset - written)
+				&& std::fwrite(buckets, sizeof(int), capacity, file) == (size_t)capacity;
+		delete[] buckets;
+		return std::fclose(file) == 0 && ok;
 	}
 };
 
 template <class K, class V, class H>
-const int HashMap<K, V, H>::TABLE_SIZE[] = {
-		37, 131, 521, 2053,
-		8209, 32771, 131101, 524309, 2097169,
-		8388617, 33554467, 134217757,
-		536870923, 1073741827 };
-
-/*
-const int HashMap<K, V, H>::TABLE_SIZE[] = {
-		17, 37, 67, 131, 257, 521, 1031, 2053, 4099,
-		8209, 16411, 32771, 65537, 131101, 262147, 524309, 1048583, 2097169,
-		4194319, 8388617, 16777259, 33554467, 67108879, 134217757,
-		268435459, 536870923, 1073741827 };
-*/
+const int HashMap<K, V, H>::PREFETCH_BATCH;
 
 #endif
@@ -0,0 +1,46 @@
+/** @file HashMapSnapshot.h
+ * On-disk layout shared by HashMap::saveSnapshot and MappedHashMap.
+ *
+ * A snapshot is a header followed by an entry array and a bucket array, each
+ * starting at a multiple of SNAPSHOT_ALIGN. Buckets and chain links are entry
+ * indices (-1 ends a chain), never pointers, so the file can be mapped at any
+ * address. Entries are stored in the map's iteration order and buckets use
+ * the map's own capacity and hash codes, so a lookup needs the same H.
+ * Integers are stored in native byte order.
+ */
+
+#ifndef __HASHMAPSNAPSHOT_H
+#define __HASHMAPSNAPSHOT_H
+
+#include <cstdio>
+
+static const char SNAPSHOT_MAGIC[8] = { 'H', 'M', 'S', 'N', 'A', 'P', '1', '\0' };
+static const unsigned long long SNAPSHOT_ALIGN = 64;
+
+struct HashMapSnapshotHeader {
+	char magic[8];
+	unsigned int keySize, valueSize, entrySize;
+	int capacity, size;
+	int reserved;
+	unsigned long long entriesOffset, bucketsOffset, fileSize;
+};
+
+template <class K, class V>
+struct HashMapSnapshotEntry {
+	int hashCode;
+	int next;
+	K key;
+	V value;
+};
+
+inline unsigned long long snapshotAlign(unsigned long long offset) {
+	return (offset + SNAPSHOT_ALIGN - 1) / SNAPSHOT_ALIGN * SNAPSHOT_ALIGN;
+}
+
+// writes n < SNAPSHOT_ALIGN zero bytes
+inline bool snapshotPad(std::FILE *file, unsigned long long n) {
+	static const char zeros[SNAPSHOT_ALIGN] = { 0 };
+	return n == 0 || std::fwrite(zeros, (size_t)n, 1, file) == 1;
+}
+
+#endif /* __HASHMAPSNAPSHOT_H */
@@ -0,0 +1,165 @@
+/** @file */
+
+#ifndef __HASHSET_H
+#define __HASHSET_H
+
+#include "ChainedHashTable.h"
+#include "ElementNotExist.h"
+
+// value type of the table under a HashSet; it adds a byte, plus padding, to each node
+struct HashSetNoValue {
+};
+
+/**
+ * Set counterpart of HashMap, on the same ChainedHashTable: prime-sized bucket
+ * chains, insertion-order list, node pool and incremental rehash, with an
+ * empty value in each node.
+ */
+template<class K, class H = DefaultHash<K> >
+class HashSet: private ChainedHashTable<K, HashSetNoValue, H> {
+private:
+	typedef ChainedHashTable<K, HashSetNoValue, H> Base;
+	typedef typename Base::List List;
+
+public:
+	/**
+	 * Visits the elements in insertion order.
+	 */
+	class Iterator {
+	private:
+		List header, p;
+	public:
+
+		Iterator(): header(NULL), p(NULL) {
+		}
+
+		Iterator(const HashSet<K, H> &set): header(set.header), p(header) {
+		}
+
+		bool hasNext() const {
+			return header != NULL && p != NULL && p->r != header;
+		}
+
+		const K& next() {
+			if (!hasNext())
+				throw ElementNotExist("");
+			p = p->r;
+			return p->key();
+		}
+	};
+
+	typedef typename Base::MemoryUsage MemoryUsage;
+
+	using Base::clear;
+	using Base::compact;
+	using Base::hashOf;
+	using Base::isEmpty;
+	using Base::memoryUsage;
+	using Base::reserve;
+	using Base::setAutoShrink;
+	using Base::setIncrementalRehash;
+	using Base::size;
+
+	HashSet() {
+	}
+
+	/**
+	 * Creates a set whose bucket array already fits expectedSize elements; like
+	 * reserve(), auto-shrinking never goes below that size.
+	 */
+	explicit HashSet(int expectedSize): Base(expectedSize) {
+	}
+
+	Iterator iterator() const {
+		return Iterator(*this);
+	}
+
+	/**
+	 * Adds key if it is absent. Returns true if the set changed.
+	 */
+	bool add(const K &key) {
+		return add(key, this->getHashCode.hashCode(key));
+	}
+
+	bool add(const K &key, int code) {
+		this->migrate(Base::REHASH_STEP);
+		List &head = this->bucket(code);
+		if (Base::findIn(head, key, code))
+			return false;
+		this->link(head, key, HashSetNoValue(), code);
+		return true;
+	}
+
+	bool contains(const K &key) const {
+		return contains(key, this->getHashCode.hashCode(key));
+	}
+
+	bool contains(const K &key, int code) const {
+		return this->findNode(key, code) != NULL;
+	}
+
+	void remove(const K &key) {
+		remove(key, this->getHashCode.hashCode(key));
+	}
+
+	void remove(const K &key, int code) {
+		this->migrate(Base::REHASH_STEP);
+		List p = this->findNode(key, code);
+		if (p == NULL)
+			throw ElementNotExist("");
+		this->eraseNode(p);
+	}
+
+	/**
+	 * Adds every element of other, reusing its cached hash codes.
+	 */
+	void unionWith(const HashSet<K, H> &other) {
+		if (&other == this) return;
+		this->growTo(this->_size + other._size);
+		for (List q = other.header->r; q != other.header; q = q->r) {
+			List &head = this->bucket(q->hashCode);
+			if (!Base::findIn(head, q->key(), q->hashCode))
+				this->linkNode(head, q->key(), HashSetNoValue(), q->hashCode);
+		}
+		this->ensureCapacity(this->_size);
+	}
+
+	/**
+	 * Keeps only the elements that other also contains.
+	 */
+	void intersectWith(const HashSet<K, H> &other) {
+		if (&other == this) return;
+		for (List p = this->header->r, next; p != this->header; p = next) {
+			next = p->r;
+			if (!other.findNode(p->key(), p->hashCode))
+				this->unlinkNode(p);
+		}
+		this->shrinkIfSparse();
+	}
+
+	/**
+	 * Removes every element that other contains, walking whichever set is smaller.
+	 */
+	void differenceWith(const HashSet<K, H> &other) {
+		if (&other == this) {
+			clear();
+			return;
+		}
+		if (other._size < this->_size) {
+			for (List q = other.header->r; q != other.header; q = q->r) {
+				List p = this->findNode(q->key(), q->hashCode);
+				if (p) this->unlinkNode(p);
+			}
+		}
+		else {
+			for (List p = this->header->r, next; p != this->header; p = next) {
+				next = p->r;
+				if (other.findNode(p->key(), p->hashCode))
+					this->unlinkNode(p);
+			}
+		}
+		this->shrinkIfSparse();
+	}
+};
+
+#endif
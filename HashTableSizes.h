@@ -0,0 +1,62 @@
+/** @file HashTableSizes.h
+ * Bucket counts shared by HashMap, HashSet and ConcurrentHashMap.
+ *
+ * Tables grow through TABLE_SIZE, primes roughly four times apart, once the
+ * load passes 1/2, so a grown table sits near 1/8. Shrinking waits for a
+ * load of SHRINK_LOAD (1/32) and goes back to at most 1/8, so a size that
+ * hovers around either threshold cannot resize back and forth.
+ */
+
+#ifndef __HASHTABLESIZES_H
+#define __HASHTABLESIZES_H
+
+// a class template only so that the tables can be defined in this header
+template <class T = void>
+class HashTableSizes {
+public:
+	const static int TABLE_SIZE[];
+	const static int TABLE_COUNT;
+	constexpr static double SHRINK_LOAD = 1.0 / 32;
+
+	// smallest TABLE_SIZE slot that holds n entries without growing
+	static int slotFor(int n) {
+		int ptr = 0;
+		while (ptr + 1 < TABLE_COUNT && TABLE_SIZE[ptr] * 0.50 < n)
+			++ptr;
+		return ptr;
+	}
+
+	// slot that a table at slot ptr holding n entries should shrink to, or ptr
+	// itself; never below floor, the slot asked for by presizing
+	static int shrinkSlot(int ptr, int floor, int n) {
+		if (ptr <= floor || TABLE_SIZE[ptr] * SHRINK_LOAD <= n)
+			return ptr;
+		int target = slotFor(n * 4);
+		if (target < floor)
+			target = floor;
+		return target < ptr ? target : ptr;
+	}
+};
+
+template <class T>
+const int HashTableSizes<T>::TABLE_SIZE[] = {
+		37, 131, 521, 2053,
+		8209, 32771, 131101, 524309, 2097169,
+		8388617, 33554467, 134217757,
+		536870923, 1073741827 };
+
+/*
+const int HashTableSizes<T>::TABLE_SIZE[] = {
+		17, 37, 67, 131, 257, 521, 1031, 2053, 4099,
+		8209, 16411, 32771, 65537, 131101, 262147, 524309, 1048583, 2097169,
+		4194319, 8388617, 16777259, 33554467, 67108879, 134217757,
+		268435459, 536870923, 1073741827 };
+*/
+
+template <class T>
+const int HashTableSizes<T>::TABLE_COUNT = sizeof(TABLE_SIZE) / sizeof(TABLE_SIZE[0]);
+
+template <class T>
+constexpr double HashTableSizes<T>::SHRINK_LOAD;
+
+#endif /* __HASHTABLESIZES_H */
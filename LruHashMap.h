@@ -0,0 +1,125 @@
+/** @file */
+
+#ifndef __LRUHASHMAP_H
+#define __LRUHASHMAP_H
+
+#include "ElementNotExist.h"
+#include "HashMap.h"
+
+/**
+ * Bounded cache built on HashMap's insertion-order list.
+ *
+ * The list runs from the least to the most recently used entry: get, tryGet
+ * and put move the entry to the back in O(1), and once the map holds more than
+ * the capacity limit, entries are evicted from the front. peek, containsKey
+ * and iteration leave the order untouched. Each access costs one hash lookup.
+ */
+template<class K, class V, class H = DefaultHash<K> >
+class LruHashMap: private HashMap<K, V, H> {
+private:
+	typedef HashMap<K, V, H> Base;
+	typedef typename Base::List List;
+
+	int limit; // 0: unbounded
+
+	void evict() {
+		while (limit > 0 && this->_size > limit)
+			this->eraseNode(this->header->r);
+	}
+
+public:
+	typedef typename Base::Entry Entry;
+	typedef typename Base::EntryRef EntryRef;
+	typedef typename Base::Iterator Iterator;
+	typedef typename Base::MemoryUsage MemoryUsage;
+
+	using Base::clear;
+	using Base::containsKey;
+	using Base::containsValue;
+	using Base::hashOf;
+	using Base::isEmpty;
+	using Base::iterator;
+	using Base::memoryUsage;
+	using Base::remove;
+	using Base::setIncrementalRehash;
+	using Base::size;
+
+	/**
+	 * Creates a cache holding at most capacityLimit entries (no limit when 0).
+	 */
+	explicit LruHashMap(int capacityLimit = 0): Base(capacityLimit), limit(capacityLimit) {
+	}
+
+	/**
+	 * Returns the value mapped to key and marks the entry as most recently used.
+	 */
+	const V& get(const K &key) {
+		return get(key, this->getHashCode.hashCode(key));
+	}
+
+	const V& get(const K &key, int code) {
+		List p = this->findNode(key, code);
+		if (p == NULL)
+			throw ElementNotExist("");
+		this->moveToBack(p);
+		return p->value();
+	}
+
+	/**
+	 * Like get, but returns NULL for an absent key.
+	 */
+	V* tryGet(const K &key) {
+		return tryGet(key, this->getHashCode.hashCode(key));
+	}
+
+	V* tryGet(const K &key, int code) {
+		List p = this->findNode(key, code);
+		if (p == NULL)
+			return NULL;
+		this->moveToBack(p);
+		return &p->value();
+	}
+
+	/**
+	 * Returns the value mapped to key without changing the eviction order.
+	 */
+	const V& peek(const K &key) const {
+		return Base::get(key);
+	}
+
+	/**
+	 * Maps key to value as the most recently used entry, evicting the least
+	 * recently used entries if the limit is exceeded.
+	 */
+	void put(const K &key, const V &value) {
+		put(key, value, this->getHashCode.hashCode(key));
+	}
+
+	void put(const K &key, const V &value, int code) {
+		this->migrate(Base::REHASH_STEP);
+		List &head = this->bucket(code);
+		List p = Base::findIn(head, key, code);
+		if (p) {
+			p->value() = value;
+			this->moveToBack(p);
+		}
+		else {
+			this->link(head, key, value, code);
+			evict();
+		}
+	}
+
+	/**
+	 * Sets the maximum number of entries (0 for no limit), evicting at once if needed.
+	 */
+	void setCapacityLimit(int capacityLimit) {
+		limit = capacityLimit;
+		evict();
+	}
+
+	int getCapacityLimit() const {
+		return limit;
+	}
+};
+
+#endif
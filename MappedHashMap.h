@@ -0,0 +1,198 @@
+/** @file */
+
+#ifndef __MAPPEDHASHMAP_H
+#define __MAPPEDHASHMAP_H
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ElementNotExist.h"
+#include "HashMap.h"
+#include "HashMapSnapshot.h"
+
+/**
+ * Read-only view of a snapshot written by HashMap<K, V, H>::saveSnapshot.
+ *
+ * open() maps the file and validates its header in O(1); lookups then run
+ * directly against the mapped bucket and entry arrays, so each page is read
+ * from disk the first time a lookup touches it. Every bucket and chain link is
+ * checked as a lookup follows it: saveSnapshot links each entry to an earlier
+ * one, so a link that is out of range or does not point backwards ends the
+ * chain, and a damaged or hostile file can neither send a lookup outside the
+ * entry array nor make it loop.
+ * Use copyTo() to load the entries into a mutable HashMap.
+ */
+template<class K, class V, class H = DefaultHash<K> >
+class MappedHashMap {
+private:
+	typedef HashMapSnapshotEntry<K, V> SnapshotEntry;
+
+	H getHashCode;
+	void *base;
+	size_t length;
+	const HashMapSnapshotHeader *head;
+	const SnapshotEntry *entries;
+	const int *buckets;
+
+	MappedHashMap(const MappedHashMap<K, V, H> &);
+	MappedHashMap<K, V, H>& operator = (const MappedHashMap<K, V, H> &);
+
+	const SnapshotEntry* find(const K &key) const {
+		if (head == NULL)
+			return NULL;
+		int code = getHashCode.hashCode(key), h = code % head->capacity;
+		if (h < 0) h += head->capacity;
+		int size = head->size;
+		for (int i = buckets[h], bound = size; i >= 0 && i < bound; bound = i, i = entries[i].next)
+			if (entries[i].hashCode == code && entries[i].key == key)
+				return entries + i;
+		return NULL;
+	}
+
+	// offsets come from the file, so the regions are compared by subtraction, which cannot wrap
+	bool valid(const HashMapSnapshotHeader *h) const {
+		return length >= sizeof(HashMapSnapshotHeader)
+				&& std::memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic)) == 0
+				&& h->keySize == sizeof(K) && h->valueSize == sizeof(V) && h->entrySize == sizeof(SnapshotEntry)
+				&& h->capacity > 0 && h->size >= 0 && h->fileSize == length
+				&& h->entriesOffset % SNAPSHOT_ALIGN == 0 && h->bucketsOffset % SNAPSHOT_ALIGN == 0
+				&& sizeof(HashMapSnapshotHeader) <= h->entriesOffset
+				&& h->entriesOffset <= h->bucketsOffset && h->bucketsOffset <= length
+				&& (unsigned long long)h->size * sizeof(SnapshotEntry) <= h->bucketsOffset - h->entriesOffset
+				&& (unsigned long long)h->capacity * sizeof(int) <= length - h->bucketsOffset;
+	}
+
+public:
+	class EntryRef {
+	private:
+		const SnapshotEntry *e;
+	public:
+		explicit EntryRef(const SnapshotEntry *e): e(e) {
+		}
+		const K& getKey() const {
+			return e->key;
+		}
+		const V& getValue() const {
+			return e->value;
+		}
+	};
+
+	/**
+	 * Visits the entries in the iteration order of the map that was saved.
+	 */
+	class Iterator {
+	private:
+		const SnapshotEntry *p, *end;
+	public:
+		Iterator(): p(NULL), end(NULL) {
+		}
+
+		Iterator(const SnapshotEntry *p, const SnapshotEntry *end): p(p), end(end) {
+		}
+
+		bool hasNext() const {
+			return p != end;
+		}
+
+		EntryRef next() {
+			if (!hasNext())
+				throw ElementNotExist("");
+			return EntryRef(p++);
+		}
+	};
+
+	MappedHashMap(): getHashCode(), base(NULL), length(0), head(NULL), entries(NULL), buckets(NULL) {
+	}
+
+	~MappedHashMap() {
+		close();
+	}
+
+	/**
+	 * Maps the snapshot at path, replacing any snapshot opened before.
+	 * Returns false if the file cannot be mapped, was not written for this K and V,
+	 * or has a header whose arrays do not fit in the file.
+	 */
+	bool open(const char *path) {
+		close();
+		int fd = ::open(path, O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+			::close(fd);
+			return false;
+		}
+		length = (size_t)st.st_size;
+		base = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (base == MAP_FAILED) {
+			base = NULL;
+			length = 0;
+			return false;
+		}
+		const HashMapSnapshotHeader *h = static_cast<const HashMapSnapshotHeader*>(base);
+		if (!valid(h)) {
+			close();
+			return false;
+		}
+		const char *bytes = static_cast<const char*>(base);
+		head = h;
+		entries = reinterpret_cast<const SnapshotEntry*>(bytes + h->entriesOffset);
+		buckets = reinterpret_cast<const int*>(bytes + h->bucketsOffset);
+		return true;
+	}
+
+	void close() {
+		if (base)
+			munmap(base, length);
+		base = NULL;
+		length = 0;
+		head = NULL;
+		entries = NULL;
+		buckets = NULL;
+	}
+
+	bool isOpen() const {
+		return head != NULL;
+	}
+
+	Iterator iterator() const {
+		return head ? Iterator(entries, entries + head->size) : Iterator();
+	}
+
+	bool containsKey(const K &key) const {
+		return find(key) != NULL;
+	}
+
+	const V& get(const K &key) const {
+		const SnapshotEntry *e = find(key);
+		if (e == NULL)
+			throw ElementNotExist("");
+		return e->value;
+	}
+
+	bool isEmpty() const {
+		return size() == 0;
+	}
+
+	int size() const {
+		return head ? head->size : 0;
+	}
+
+	/**
+	 * Puts every entry of the snapshot into map, sizing it once up front and
+	 * reusing the stored hash codes instead of rehashing the keys.
+	 */
+	void copyTo(HashMap<K, V, H> &map) const {
+		if (head == NULL)
+			return;
+		map.growTo(map.size() + head->size);
+		for (int i = 0; i < head->size; ++i)
+			map.put(entries[i].key, entries[i].value, entries[i].hashCode);
+	}
+};
+
+#endif
@@ -0,0 +1,172 @@
+/** @file NodePool.h
+ * Slab allocator for the fixed-size nodes of one container.
+ * Memory is taken from the system in slabs of growing size and handed out
+ * one node at a time; freed nodes go onto a free list for reuse.
+ * The pool only manages raw memory: callers construct and destroy the nodes.
+ *
+ * Slabs are reference counted, so a container that hands some of its nodes
+ * to another (TreeMap::splitAt) can let both pools hold the same slabs.
+ * Slabs are never written once made; the free list and the run of unused
+ * cells belong to one pool, so two pools never hand out the same cell.
+ */
+
+#ifndef __NODEPOOL_H
+#define __NODEPOOL_H
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+template <class N>
+class NodePool {
+private:
+	union Cell {
+		Cell *next;
+		typename std::aligned_storage<sizeof(N), std::alignment_of<N>::value>::type storage;
+	};
+
+	// one slab of cells; prev is the slab made before it, and joined, set only on
+	// the cell-less slab that splice() adds, is the newest slab of the other pool
+	struct Slab {
+		Cell *cells;
+		std::shared_ptr<Slab> prev, joined;
+
+		Slab(Cell *cells, std::shared_ptr<Slab> prev, std::shared_ptr<Slab> joined):
+			cells(cells), prev(std::move(prev)), joined(std::move(joined)) {
+		}
+
+		~Slab() {
+			delete[] cells;
+			// slabs only this one still holds are unlinked in a loop, not by recursion
+			while (prev && prev.use_count() == 1) {
+				std::shared_ptr<Slab> p = std::move(prev);
+				prev = std::move(p->prev);
+			}
+		}
+	};
+
+	static const int FIRST_SLAB = 32;
+	static const int MAX_SLAB = 8192;
+
+	std::shared_ptr<Slab> slabs; // the newest slab; the rest are reached through it
+	Cell *cursor, *limit; // untouched cells of a slab of this pool
+	Cell *freeList, *freeTail;
+	int nextSlab;
+	size_t reserved;
+
+	NodePool(const NodePool &);
+	NodePool& operator = (const NodePool &);
+
+	void grow() {
+		Cell *cells = new Cell[nextSlab];
+		try {
+			slabs = std::make_shared<Slab>(cells, std::move(slabs), std::shared_ptr<Slab>());
+		}
+		catch (...) {
+			delete[] cells;
+			throw;
+		}
+		cursor = cells;
+		limit = cells + nextSlab;
+		reserved += (size_t)nextSlab * sizeof(Cell);
+		if (nextSlab < MAX_SLAB) nextSlab <<= 1;
+	}
+
+	void reset() {
+		cursor = limit = freeList = freeTail = NULL;
+		nextSlab = FIRST_SLAB;
+		reserved = 0;
+	}
+
+public:
+	NodePool(): cursor(NULL), limit(NULL), freeList(NULL), freeTail(NULL), nextSlab(FIRST_SLAB), reserved(0) {
+	}
+
+	N* allocate() {
+		if (freeList) {
+			Cell *c = freeList;
+			freeList = c->next;
+			return reinterpret_cast<N*>(c);
+		}
+		if (cursor == limit)
+			grow();
+		return reinterpret_cast<N*>(cursor++);
+	}
+
+	void deallocate(N *p) {
+		Cell *c = reinterpret_cast<Cell*>(p);
+		c->next = freeList;
+		if (freeList == NULL) freeTail = c;
+		freeList = c;
+	}
+
+	/**
+	 * Lets go of every slab at once; a slab goes back to the system when no
+	 * pool holds it any more. Nodes still alive are not destroyed.
+	 */
+	void release() {
+		slabs.reset();
+		reset();
+	}
+
+	/**
+	 * Makes other, which must be empty, hold this pool's slabs too, in O(1),
+	 * so nodes moved to other's container stay valid. other gets no free or
+	 * unused cells: what it frees it reuses, and it grows into slabs of its own.
+	 */
+	void share(NodePool &other) const {
+		other.slabs = slabs;
+	}
+
+	/**
+	 * Takes over every slab of other in O(1), leaving other empty. Nodes
+	 * allocated from other stay in place and are freed to this pool from now on.
+	 * Of the two runs of never-used cells only the longer one is kept.
+	 */
+	void splice(NodePool &other) {
+		if (&other == this)
+			return;
+		if (other.slabs && other.slabs != slabs)
+			slabs = slabs ? std::make_shared<Slab>((Cell*)NULL, std::move(slabs), std::move(other.slabs)) : std::move(other.slabs);
+		if (other.freeList) {
+			other.freeTail->next = freeList;
+			if (freeList == NULL) freeTail = other.freeTail;
+			freeList = other.freeList;
+		}
+		if (other.limit - other.cursor > limit - cursor) {
+			cursor = other.cursor;
+			limit = other.limit;
+		}
+		if (other.nextSlab > nextSlab) nextSlab = other.nextSlab;
+		reserved += other.reserved;
+		other.slabs.reset();
+		other.reset();
+	}
+
+	void swap(NodePool &other) {
+		std::swap(slabs, other.slabs);
+		std::swap(cursor, other.cursor);
+		std::swap(limit, other.limit);
+		std::swap(freeList, other.freeList);
+		std::swap(freeTail, other.freeTail);
+		std::swap(nextSlab, other.nextSlab);
+		std::swap(reserved, other.reserved);
+	}
+
+	/**
+	 * Bytes of the slabs this pool made or took over, used or not; slabs
+	 * only shared with it are not counted.
+	 */
+	size_t bytesReserved() const {
+		return reserved;
+	}
+};
+
+template <class N>
+const int NodePool<N>::FIRST_SLAB;
+
+template <class N>
+const int NodePool<N>::MAX_SLAB;
+
+#endif /* __NODEPOOL_H */
@@ -4,11 +4,16 @@
 #define __TREEMAP_H
 
 #include <ctime>
+#include <new>
+#include <type_traits>
+#include <utility>
 #include "ElementNotExist.h"
+#include "IndexOutOfBound.h"
+#include "NodePool.h"
 
 template <class K, class V>
 class TreeMap {
-private:
+protected:
 	typedef K* Kp;
 	typedef V* Vp;
 
@@ -52,124 +57,386 @@ public:
 		}
 	};
 
-private:
+	/**
+	 * Non-owning view of an entry, valid until that entry is removed.
+	 */
+	class EntryRef {
+	private:
+		const K *key;
+		const V *value;
+	public:
+		EntryRef(const K &key, const V &value): key(&key), value(&value) {
+		}
+		const K& getKey() const {
+			return *key;
+		}
+		const V& getValue() const {
+			return *value;
+		}
+	};
+
+	/**
+	 * Like EntryRef, but the value may be modified in place.
+	 */
+	class MutableEntryRef {
+	private:
+		const K *key;
+		V *value;
+	public:
+		MutableEntryRef(const K &key, V &value): key(&key), value(&value) {
+		}
+		const K& getKey() const {
+			return *key;
+		}
+		V& getValue() const {
+			return *value;
+		}
+		void setValue(const V &v) const {
+			*value = v;
+		}
+	};
+
+protected:
 	class Node {
 	public:
-		Kp key;
-		Vp value;
 		unsigned prio;
+		int count; // nodes in this subtree; 0 for the null sentinel
 		Node *ch[2], *pre;
-		Node(): key(NULL), value(NULL), prio(2147483647U), pre(this) {
+
+		// key and value are constructed in place for entry nodes only, never for the null sentinel
+		typename std::aligned_storage<sizeof(K), std::alignment_of<K>::value>::type keyStorage;
+		typename std::aligned_storage<sizeof(V), std::alignment_of<V>::value>::type valueStorage;
+
+		Node(): prio(2147483647U), count(0), pre(this) {
 			ch[0] = ch[1] = this;
 		}
-		Node(const K &key, const V &value, int prio, Node *null):
-			key(new K(key)), value(new V(value)), prio(prio), pre(null) {
+
+		template <class KArg, class VArg>
+		Node(KArg &&key, VArg &&value, unsigned prio, Node *null): prio(prio), count(1), pre(null) {
 			ch[0] = ch[1] = null;
-		}
-		~Node() {
-			if (key) {
-				delete key;
+			new (&keyStorage) K(std::forward<KArg>(key));
+			try {
+				new (&valueStorage) V(std::forward<VArg>(value));
 			}
-			if (value) {
-				delete value;
+			catch (...) {
+				this->key().~K();
+				throw;
 			}
 		}
+
+		K& key() {
+			return *reinterpret_cast<K*>(&keyStorage);
+		}
+
+		V& value() {
+			return *reinterpret_cast<V*>(&valueStorage);
+		}
 	};
 
-private:
+protected:
 	typedef Node *Tree;
 
 	int _size;
 	Tree null, root;
+	NodePool<Node> nodes; // its slabs may also be held by maps split off this one
 
-	void deleteTree(Tree t) {
-		if (t == null) return;
-		deleteTree(t->ch[0]);
-		deleteTree(t->ch[1]);
-		delete t;
+	// one sentinel for every map of this type, so subtrees can move between maps;
+	// it is never written after construction
+	static Tree sentinel() {
+		static Node nil;
+		return &nil;
 	}
 
-	Tree cloneTree(Tree t, Tree newNull) const {
-		if (t == null) return newNull;
-		Tree ret = new Node(*t->key, *t->value, t->prio, newNull);
-		Tree lc = ret->ch[0] = cloneTree(t->ch[0], newNull);
-		Tree rc = ret->ch[1] = cloneTree(t->ch[1], newNull);
-		if (lc != newNull) lc->pre = ret;
-		if (rc != newNull) rc->pre = ret;
-		return ret;
+	Tree newNode(const K &key, const V &value, unsigned prio) {
+		Tree p = nodes.allocate();
+		try {
+			return new (p) Node(key, value, prio, null);
+		}
+		catch (...) {
+			nodes.deallocate(p);
+			throw;
+		}
+	}
+
+	void deleteNode(Tree t) {
+		t->key().~K();
+		t->value().~V();
+		nodes.deallocate(t);
+	}
+
+	// destroys every entry and lets go of the pool's slabs at once
+	void deleteTree() {
+		if (!std::is_trivially_destructible<K>::value || !std::is_trivially_destructible<V>::value)
+			for (Tree p = firstNode(); p != null; p = successor(p)) { // successor reads only the links
+				p->key().~K();
+				p->value().~V();
+			}
+		nodes.release();
+		root = null;
+	}
+
+	// copies other's tree shape and priorities into this empty map, walking both in preorder
+	void cloneFrom(const TreeMap<K, V> &other) {
+		if (other.root == other.null)
+			return;
+		Tree src = other.root, dst = root = newNode(src->key(), src->value(), src->prio);
+		root->count = src->count;
+		for (;;) {
+			int d;
+			if (src->ch[0] != other.null && dst->ch[0] == null)
+				d = 0;
+			else if (src->ch[1] != other.null && dst->ch[1] == null)
+				d = 1;
+			else {
+				if (src == other.root)
+					break;
+				src = src->pre;
+				dst = dst->pre;
+				continue;
+			}
+			src = src->ch[d];
+			Tree c = newNode(src->key(), src->value(), src->prio);
+			c->count = src->count;
+			c->pre = dst;
+			dst = dst->ch[d] = c;
+		}
+	}
+
+	void replaceChild(Tree parent, Tree from, Tree to) {
+		if (parent == null)
+			root = to;
+		else
+			parent->ch[parent->ch[1] == from] = to;
 	}
 
-	void cloneTo(Tree &newRoot, Tree &newNull) const {
-		newNull = new Node();
-		newRoot = cloneTree(root, newNull);
-		newRoot->pre = newNull;
+	void rotateUp(Tree x) { // x takes the place of its parent
+		Tree p = x->pre;
+		int d = p->ch[1] == x;
+		p->ch[d] = x->ch[!d];
+		if (p->ch[d] != null) p->ch[d]->pre = p;
+		replaceChild(p->pre, p, x);
+		x->pre = p->pre;
+		x->ch[!d] = p;
+		p->pre = x;
+		p->count = p->ch[0]->count + p->ch[1]->count + 1;
+		x->count = p->count + x->ch[d]->count + 1;
 	}
 
-	void rotate(Tree &x, int d) { // rotate x into ch[d]
-		Tree y = x->ch[!d];
-		x->ch[!d] = y->ch[d];
-		if (x->ch[!d] != null) x->ch[!d]->pre = x;
-		y->ch[d] = x;
-		y->pre = x->pre;
-		x->pre = y;
-		x = y;
+	// adds delta to the subtree counts of p and all its ancestors
+	void addCount(Tree p, int delta) {
+		for (; p != null; p = p->pre)
+			p->count += delta;
 	}
 
-	bool insert(Tree &x, const K &key, const V &value) {
-		if (x == null) {
-			x = new Node(key, value, nextUnsigned(), null);
-			return true;
+	bool insert(const K &key, const V &value) {
+		Tree parent = null;
+		int d = 0;
+		for (Tree p = root; p != null; p = p->ch[d]) {
+			if (p->key() == key) {
+				p->value() = value;
+				return false;
+			}
+			parent = p;
+			d = p->key() < key;
+		}
+		Tree x = newNode(key, value, nextUnsigned());
+		x->pre = parent;
+		if (parent == null)
+			root = x;
+		else
+			parent->ch[d] = x;
+		addCount(parent, 1);
+		while (x->pre != null && x->prio < x->pre->prio)
+			rotateUp(x);
+		return true;
+	}
+
+	bool erase(const K &key) {
+		Tree x = searchForKey(key);
+		if (x == null) return false;
+		eraseNode(x);
+		return true;
+	}
+
+	// unlinks x and frees it, leaving every other node where it is; _size is the caller's
+	void eraseNode(Tree x) {
+		while (x->ch[0] != null && x->ch[1] != null) // rotate x down past its higher-priority child
+			rotateUp(x->ch[x->ch[1]->prio < x->ch[0]->prio]);
+		Tree c = x->ch[x->ch[0] == null];
+		if (c != null) c->pre = x->pre;
+		replaceChild(x->pre, x, c);
+		addCount(x->pre, -1);
+		deleteNode(x);
+	}
+
+	void setChild(Tree p, int d, Tree c) {
+		p->ch[d] = c;
+		if (c != null) c->pre = p;
+	}
+
+	void pullCount(Tree p) {
+		p->count = p->ch[0]->count + p->ch[1]->count + 1;
+	}
+
+	// splits t into the keys < key (<= key if inclusive) and the rest, walking one path
+	void splitTree(Tree t, const K &key, bool inclusive, Tree &lo, Tree &hi) {
+		Tree lp = null, hp = null;
+		lo = hi = null;
+		while (t != null) {
+			if (inclusive ? !(key < t->key()) : t->key() < key) {
+				if (lp == null) lo = t; else lp->ch[1] = t;
+				t->pre = lp;
+				lp = t;
+				t = t->ch[1];
+			}
+			else {
+				if (hp == null) hi = t; else hp->ch[0] = t;
+				t->pre = hp;
+				hp = t;
+				t = t->ch[0];
+			}
 		}
-		if (*x->key == key) {
-			delete x->value;
-			x->value = new V(value);
-			return false;
+		if (lp != null) lp->ch[1] = null;
+		if (hp != null) hp->ch[0] = null;
+		for (; lp != null; lp = lp->pre) pullCount(lp);
+		for (; hp != null; hp = hp->pre) pullCount(hp);
+	}
+
+	// joins treaps a and b where every key of a is less than every key of b
+	Tree joinTrees(Tree a, Tree b) {
+		Tree ret = null, parent = null;
+		int d = 0;
+		while (a != null && b != null) {
+			Tree x;
+			int next;
+			if (a->prio < b->prio) { // x keeps its left subtree; the rest joins on its right
+				x = a;
+				a = a->ch[1];
+				next = 1;
+			}
+			else {
+				x = b;
+				b = b->ch[0];
+				next = 0;
+			}
+			if (parent == null) {
+				ret = x;
+				x->pre = null;
+			}
+			else
+				setChild(parent, d, x);
+			parent = x;
+			d = next;
 		}
-		int d = *x->key < key;
-		bool ret = insert(x->ch[d], key, value);
-		x->ch[d]->pre = x;
-		if (x->ch[d]->prio < x->prio)
-			rotate(x, !d);
+		Tree rest = a != null ? a : b;
+		if (parent == null)
+			ret = rest;
+		else
+			setChild(parent, d, rest);
+		for (; parent != null; parent = parent->pre) pullCount(parent);
 		return ret;
 	}
 
-	Tree downToLeaf(Tree x) {
-		if (x->ch[0] == null) {
-			Tree ret = x->ch[1];
-			delete x;
-			return ret;
+	// union of treaps x and y; for keys in both, y's entry survives. Recursion
+	// depth is bounded by the heights of the treaps.
+	Tree uniteTrees(Tree x, Tree y) {
+		if (x == null) return y;
+		if (y == null) return x;
+		Tree top, l, r, eq, rest;
+		if (x->prio < y->prio) {
+			top = x;
+			splitTree(y, x->key(), false, l, rest);
+			splitTree(rest, x->key(), true, eq, r);
+			if (eq != null) {
+				x->value() = std::move(eq->value());
+				deleteNode(eq);
+			}
+			setChild(top, 0, uniteTrees(x->ch[0], l));
+			setChild(top, 1, uniteTrees(x->ch[1], r));
 		}
-		if (x->ch[1] == null) {
-			Tree ret = x->ch[0];
-			delete x;
-			return ret;
+		else {
+			top = y;
+			splitTree(x, y->key(), false, l, rest);
+			splitTree(rest, y->key(), true, eq, r);
+			if (eq != null)
+				deleteNode(eq);
+			setChild(top, 0, uniteTrees(l, y->ch[0]));
+			setChild(top, 1, uniteTrees(r, y->ch[1]));
 		}
-		int d = x->ch[0]->prio < x->ch[1]->prio;
-		rotate(x, d);
-		x->ch[d] = downToLeaf(x->ch[d]);
-		if (x->ch[d] != null)
-			x->ch[d]->pre = x;
-		return x;
+		pullCount(top);
+		return top;
 	}
 
-	bool erase(Tree &x, const K &key) {
-		if (x == null) return false;
-		if (*x->key != key) {
-			int d = *x->key < key;
-			bool ret = erase(x->ch[d], key);
-			if (x->ch[d] != null)
-				x->ch[d]->pre = x;
-			return ret;
-		}
-		x = downToLeaf(x);
-		return true;
+	// makes every node of other one of this map's pool
+	void takeNodes(TreeMap<K, V> &other) {
+		nodes.splice(other.nodes);
+	}
+
+	Tree firstNode() const {
+		Tree p = root;
+		while (p->ch[0] != null)
+			p = p->ch[0];
+		return p;
+	}
+
+	Tree lastNode() const {
+		Tree p = root;
+		while (p->ch[1] != null)
+			p = p->ch[1];
+		return p;
+	}
+
+	// smallest node with a key >= key (> key if strict), or null
+	Tree ceilingNode(const K &key, bool strict) const {
+		Tree ret = null;
+		for (Tree t = root; t != null; )
+			if (strict ? key < t->key() : !(t->key() < key)) {
+				ret = t;
+				t = t->ch[0];
+			}
+			else
+				t = t->ch[1];
+		return ret;
+	}
+
+	// largest node with a key <= key (< key if strict), or null
+	Tree floorNode(const K &key, bool strict) const {
+		Tree ret = null;
+		for (Tree t = root; t != null; )
+			if (strict ? t->key() < key : !(key < t->key())) {
+				ret = t;
+				t = t->ch[1];
+			}
+			else
+				t = t->ch[0];
+		return ret;
+	}
+
+	const K& keyOf(Tree t) const {
+		if (t == null)
+			throw ElementNotExist("");
+		return t->key();
+	}
+
+	Tree successor(Tree p) const {
+		if (p->ch[1] != null) {
+			for (p = p->ch[1]; p->ch[0] != null; p = p->ch[0]);
+		}
+		else {
+			Tree last;
+			do {
+				last = p;
+				p = p->pre;
+			} while (p != null && p->ch[0] != last);
+		}
+		return p;
 	}
 
 	Tree searchForKey(const K &key) const {
 		for (Tree t = root; t != null; ) {
-			if (*t->key == key)
+			if (t->key() == key)
 				return t;
-			if (key < *t->key)
+			if (key < t->key())
 				t = t->ch[0];
 			else
 				t = t->ch[1];
@@ -181,80 +448,109 @@ public:
 	class Iterator {
 	private:
 		TreeMap<K, V> *from;
-		Tree p;
+		Tree p, end; // end: the first node past the range, or null
 
 	public:
-		Iterator(): from(NULL), p(NULL) {
+		Iterator(): from(NULL), p(NULL), end(NULL) {
+		}
+
+		Iterator(TreeMap<K, V> *f): from(f), p(f->firstNode()), end(f->null) {
 		}
 
-		Iterator(TreeMap<K, V> *f): from(f) {
-			Tree null = from->null;
-			for (p = from->root; p->ch[0] != null; p = p->ch[0]);
+		Iterator(TreeMap<K, V> *f, Tree first, Tree end): from(f), p(first), end(end) {
 		}
 
 		bool hasNext() const {
-			return from != NULL && p != from->null;
+			return from != NULL && p != from->null && p != end;
 		}
 		
 		const Entry next() {
-			Tree null = from->null;
 			if (!hasNext())
 				throw ElementNotExist("");
 			Tree ret = p;
-			if (p->ch[1] != null) {
-				for (p = p->ch[1]; p->ch[0] != null; p = p->ch[0]);
-			}
-			else {
-				Tree last;
-				do {
-					last = p;
-					p = p->pre;
-				} while (p != null && p->ch[0] != last);
-			}
-			return Entry(*ret->key, *ret->value);
+			p = from->successor(p);
+			return Entry(ret->key(), ret->value());
+		}
+
+		/**
+		 * Like next(), but returns a view of the entry instead of copying it.
+		 */
+		EntryRef nextRef() {
+			if (!hasNext())
+				throw ElementNotExist("");
+			Tree ret = p;
+			p = from->successor(p);
+			return EntryRef(ret->key(), ret->value());
+		}
+	};
+
+	class MutableIterator {
+	private:
+		TreeMap<K, V> *from;
+		Tree p;
+
+	public:
+		MutableIterator(): from(NULL), p(NULL) {
+		}
+
+		MutableIterator(TreeMap<K, V> *f): from(f), p(f->firstNode()) {
+		}
+
+		bool hasNext() const {
+			return from != NULL && p != from->null;
+		}
+
+		MutableEntryRef next() {
+			if (!hasNext())
+				throw ElementNotExist("");
+			Tree ret = p;
+			p = from->successor(p);
+			return MutableEntryRef(ret->key(), ret->value());
 		}
 	};
 	
-	TreeMap(): seed((unsigned int)time(NULL)), _size(0), null(new Node()), root(null) {
+	TreeMap(): seed((unsigned int)time(NULL)), _size(0), null(sentinel()), root(null) {
 	}
 
 	~TreeMap() {
-		deleteTree(root);
-		if (null) {
-			delete null;
-		}
+		deleteTree();
 	}
 	
 	TreeMap<K, V>& operator = (const TreeMap<K, V> &x) {
 		if (this != &x) {
+			deleteTree();
+			_size = 0;
+			cloneFrom(x);
 			_size = x._size;
 			seed = x.seed;
-			
-			if (null) {
-				delete null;
-			}
-
-			deleteTree(root);
-			x.cloneTo(root, null);
-
 		}
 		return *this;
 	}
 
-	TreeMap(TreeMap<K, V> &x) {
-		_size = x._size;
-		seed = x.seed;
-		x.cloneTo(root, null);
+	TreeMap(const TreeMap<K, V> &x): seed(x.seed), _size(x._size), null(sentinel()), root(null) {
+		try {
+			cloneFrom(x);
+		}
+		catch (...) {
+			deleteTree();
+			throw;
+		}
 	}
 	
 	Iterator iterator() const {
 		return Iterator(const_cast<TreeMap<K, V>*>(this));
 	}
 
+	/**
+	 * Iterates in key order like iterator(), allowing values to be updated in place.
+	 */
+	MutableIterator mutableIterator() {
+		return MutableIterator(this);
+	}
+
 	void clear() {
 		_size = 0;
-		deleteTree(root);
-		root = null;
+		deleteTree();
 	}
 
 	bool containsKey(const K &key) const {
@@ -262,8 +558,8 @@ public:
 	}
 
 	bool containsValue(const V &value) const {
-		for (Iterator itr(iterator()); itr.hasNext(); )
-			if (*itr.next().value == value)
+		for (Tree p = firstNode(); p != null; p = successor(p))
+			if (p->value() == value)
 				return true;
 		return false;
 	}
@@ -272,7 +568,7 @@ public:
 		Tree ret = searchForKey(key);
 		if (ret == null)
 			throw ElementNotExist("");
-		return *ret->value;
+		return ret->value();
 	}
 
 	bool isEmpty() const {
@@ -280,20 +576,212 @@ public:
 	}
 
 	void put(const K &key, const V &value) {
-		if ( insert(root, key, value) )
+		if (insert(key, value))
 			++_size;
 	}
 
 	void remove(const K &key) {
-		if (!erase(root, key))
+		if (!erase(key))
 			throw ElementNotExist("");
-		root->pre = null;
 		--_size;
 	}
 
 	int size() const {
 		return _size;
 	}
+
+	/**
+	 * Returns the smallest key. Throws ElementNotExist if the map is empty.
+	 */
+	const K& firstKey() const {
+		return keyOf(firstNode());
+	}
+
+	const K& lastKey() const {
+		return keyOf(lastNode());
+	}
+
+	/**
+	 * Returns the largest key <= key. Like ceilingKey, lowerKey and higherKey,
+	 * it runs in O(log n) and throws ElementNotExist if there is no such key.
+	 */
+	const K& floorKey(const K &key) const {
+		return keyOf(floorNode(key, false));
+	}
+
+	const K& ceilingKey(const K &key) const {
+		return keyOf(ceilingNode(key, false));
+	}
+
+	const K& lowerKey(const K &key) const {
+		return keyOf(floorNode(key, true));
+	}
+
+	const K& higherKey(const K &key) const {
+		return keyOf(ceilingNode(key, true));
+	}
+
+	/**
+	 * Iterates in key order over the entries with keys in [lo, hi). The start
+	 * is found in O(log n), so visiting k entries costs O(log n + k).
+	 */
+	Iterator subMap(const K &lo, const K &hi) const {
+		TreeMap<K, V> *self = const_cast<TreeMap<K, V>*>(this);
+		if (!(lo < hi))
+			return Iterator(self, null, null);
+		return Iterator(self, ceilingNode(lo, false), ceilingNode(hi, false));
+	}
+
+	/**
+	 * Iterates in key order over the entries with keys >= lo.
+	 */
+	Iterator tailMap(const K &lo) const {
+		return Iterator(const_cast<TreeMap<K, V>*>(this), ceilingNode(lo, false), null);
+	}
+
+	/**
+	 * Returns the number of keys less than key, in O(log n). key need not be present.
+	 */
+	int rank(const K &key) const {
+		int ret = 0;
+		for (Tree t = root; t != null; ) {
+			if (t->key() < key) {
+				ret += t->ch[0]->count + 1;
+				t = t->ch[1];
+			}
+			else
+				t = t->ch[0];
+		}
+		return ret;
+	}
+
+	/**
+	 * Returns the k-th smallest key, counting from 0, in O(log n).
+	 */
+	const K& select(int k) const {
+		if (k < 0 || k >= _size)
+			throw IndexOutOfBound("");
+		Tree t = root;
+		for (;;) {
+			int left = t->ch[0]->count;
+			if (k < left)
+				t = t->ch[0];
+			else if (k == left)
+				return t->key();
+			else {
+				k -= left + 1;
+				t = t->ch[1];
+			}
+		}
+	}
+
+	/**
+	 * Returns the number of keys in [lo, hi), in O(log n).
+	 */
+	int countRange(const K &lo, const K &hi) const {
+		return lo < hi ? rank(hi) - rank(lo) : 0;
+	}
+
+	/**
+	 * Moves the entries with keys >= key into right, replacing its contents, in
+	 * O(log n). Both maps hold the slabs of the moved nodes from then on, but
+	 * each allocates and frees through its own pool, so they can be used from
+	 * different threads.
+	 */
+	void splitAt(const K &key, TreeMap<K, V> &right) {
+		if (&right == this)
+			return;
+		right.clear();
+		Tree lo, hi;
+		splitTree(root, key, false, lo, hi);
+		root = lo;
+		_size = lo->count;
+		right.root = hi;
+		right._size = hi->count;
+		nodes.share(right.nodes);
+	}
+
+	/**
+	 * Moves every entry of other into this map, leaving other empty. If the key
+	 * ranges do not overlap, the treaps are joined along one path in O(log n);
+	 * otherwise this is unionWith(other).
+	 */
+	void join(TreeMap<K, V> &other) {
+		if (&other == this || other.root == null)
+			return;
+		if (root != null && lastNode()->key() < other.firstNode()->key()) {
+			takeNodes(other);
+			root = joinTrees(root, other.root);
+		}
+		else if (root == null || other.lastNode()->key() < firstNode()->key()) {
+			takeNodes(other);
+			root = joinTrees(other.root, root);
+		}
+		else {
+			unionWith(other);
+			return;
+		}
+		_size += other._size;
+		other.root = null;
+		other._size = 0;
+	}
+
+	/**
+	 * Moves every entry of other into this map, leaving other empty. For keys in
+	 * both maps other's value wins, as with put. Split-based treap union:
+	 * expected O(m log(n / m + 1)) for sizes n >= m.
+	 */
+	void unionWith(TreeMap<K, V> &other) {
+		if (&other == this)
+			return;
+		takeNodes(other);
+		root = uniteTrees(root, other.root);
+		if (root != null) root->pre = null;
+		_size = root->count;
+		other.root = null;
+		other._size = 0;
+	}
+
+	/**
+	 * Puts every (first, second) pair of [first, last), whose keys should be in
+	 * ascending order; of equal adjacent keys the last value is kept. The pairs
+	 * are built into a treap in O(m) by a stack-based Cartesian-tree build, then
+	 * joined with this map. A key that is out of order is put, with the rest of
+	 * the range, one entry at a time.
+	 */
+	template <class ForwardIterator>
+	void putAllSorted(ForwardIterator first, ForwardIterator last) {
+		TreeMap<K, V> part;
+		Tree top = null; // lowest node of the right spine, which links upward through pre
+		for (; first != last; ++first) {
+			if (top != null && !(top->key() < first->first)) {
+				if (!(top->key() == first->first))
+					break;
+				top->value() = first->second;
+				continue;
+			}
+			Tree x = part.newNode(first->first, first->second, nextUnsigned());
+			Tree below = null;
+			while (top != null && x->prio < top->prio) { // a node leaving the spine has its final subtree
+				part.pullCount(top);
+				below = top;
+				top = top->pre;
+			}
+			part.setChild(x, 0, below);
+			x->pre = top;
+			if (top == null)
+				part.root = x;
+			else
+				top->ch[1] = x;
+			top = x;
+		}
+		for (; top != null; top = top->pre)
+			part.pullCount(top);
+		part._size = part.root->count;
+		join(part);
+		for (; first != last; ++first)
+			put(first->first, first->second);
+	}
 };
 
 #endif /* __TREEMAP_H */
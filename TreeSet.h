@@ -0,0 +1,123 @@
+/** @file */
+
+#ifndef __TREESET_H
+#define __TREESET_H
+
+#include "ElementNotExist.h"
+#include "TreeMap.h"
+
+// value type of the TreeMap under a TreeSet; it adds a byte, plus padding, to each node
+struct TreeSetNoValue {
+};
+
+/**
+ * Ordered set on TreeMap's treap: the same pooled, counted nodes with an
+ * empty value in each.
+ */
+template <class K>
+class TreeSet: private TreeMap<K, TreeSetNoValue> {
+private:
+	typedef TreeMap<K, TreeSetNoValue> Base;
+	typedef typename Base::Tree Tree;
+
+	// walks this set and other in order side by side, erasing every element whose
+	// presence in other equals dropIfFound; erasing a node leaves the others in place
+	void eraseWhere(const TreeSet<K> &other, bool dropIfFound) {
+		Tree q = other.firstNode();
+		for (Tree p = this->firstNode(), next; p != this->null; p = next) {
+			while (q != other.null && q->key() < p->key())
+				q = other.successor(q);
+			if (dropIfFound && q == other.null)
+				break;
+			next = this->successor(p);
+			if ((q != other.null && q->key() == p->key()) == dropIfFound) {
+				this->eraseNode(p);
+				--this->_size;
+			}
+		}
+	}
+
+public:
+	/**
+	 * Visits the elements in ascending order.
+	 */
+	class Iterator {
+	private:
+		const TreeSet<K> *from;
+		Tree p;
+
+	public:
+		Iterator(): from(NULL), p(NULL) {
+		}
+
+		Iterator(const TreeSet<K> *f): from(f), p(f->firstNode()) {
+		}
+
+		bool hasNext() const {
+			return from != NULL && p != from->null;
+		}
+
+		const K& next() {
+			if (!hasNext())
+				throw ElementNotExist("");
+			Tree ret = p;
+			p = from->successor(p);
+			return ret->key();
+		}
+	};
+
+	using Base::clear;
+	using Base::isEmpty;
+	using Base::remove;
+	using Base::size;
+
+	Iterator iterator() const {
+		return Iterator(this);
+	}
+
+	/**
+	 * Adds key if it is absent. Returns true if the set changed.
+	 */
+	bool add(const K &key) {
+		if (!this->insert(key, TreeSetNoValue()))
+			return false;
+		++this->_size;
+		return true;
+	}
+
+	bool contains(const K &key) const {
+		return this->searchForKey(key) != this->null;
+	}
+
+	/**
+	 * Adds every element of other: a copy of other is merged in by TreeMap's
+	 * split-based union, in expected O(m log(n / m + 1)) after the O(m) copy.
+	 */
+	void unionWith(const TreeSet<K> &other) {
+		if (&other == this) return;
+		TreeSet<K> copy(other);
+		Base::unionWith(copy);
+	}
+
+	/**
+	 * Keeps only the elements that other also contains. Both sets are walked
+	 * in order side by side and the other elements are erased on the way.
+	 */
+	void intersectWith(const TreeSet<K> &other) {
+		if (&other == this) return;
+		eraseWhere(other, false);
+	}
+
+	/**
+	 * Removes every element that other contains, finding them in one merged walk.
+	 */
+	void differenceWith(const TreeSet<K> &other) {
+		if (&other == this) {
+			clear();
+			return;
+		}
+		eraseWhere(other, true);
+	}
+};
+
+#endif /* __TREESET_H */
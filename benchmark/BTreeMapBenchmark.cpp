@@ -0,0 +1,71 @@
+/** @file
+ * Lookup and scan throughput of BTreeMap against the TreeMap treap.
+ *
+ * Build from the repository root:
+ *     g++ -std=c++11 -O2 -I. benchmark/BTreeMapBenchmark.cpp -o btree_bench
+ * Usage: btree_bench [maxSize] [lookups]
+ *
+ * Both maps are filled with the same random int keys. Lookups are gets of
+ * present keys in random order; a scan walks every entry with the iterator.
+ * The size grows by a factor of four from 1024 to maxSize (default 2^22).
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "../BTreeMap.h"
+#include "../TreeMap.h"
+
+static long long checksum; // printed, so that the loops cannot be optimized away
+
+struct Rates {
+	double get, scan;
+};
+
+template <class Map>
+static Rates run(const std::vector<int> &keys, const std::vector<int> &probes) {
+	Map map;
+	for (size_t i = 0; i < keys.size(); ++i)
+		map.put(keys[i], (int)i);
+	Rates rates;
+	long long sum = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < probes.size(); ++i)
+		sum += map.get(probes[i]);
+	rates.get = probes.size() / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	int rounds = 0;
+	long long visited = 0;
+	start = std::chrono::steady_clock::now();
+	do { // at least 10^7 entries, so small maps are not timed on a single pass
+		for (typename Map::Iterator it = map.iterator(); it.hasNext(); ++visited)
+			sum += it.nextRef().getValue();
+		++rounds;
+	} while (visited < 10000000);
+	rates.scan = visited / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	checksum += sum + rounds;
+	return rates;
+}
+
+int main(int argc, char **argv) {
+	int maxSize = argc > 1 ? std::atoi(argv[1]) : 1 << 22;
+	int lookups = argc > 2 ? std::atoi(argv[2]) : 5000000;
+	std::printf("lookups: %d\n", lookups);
+	std::printf("%10s %12s %12s %12s %12s\n", "size", "TreeMap get", "BTree get", "TreeMap scan", "BTree scan");
+	std::printf("%10s %12s %12s %12s %12s\n", "", "Mops/s", "Mops/s", "Mentries/s", "Mentries/s");
+	std::mt19937 rng(12345);
+	for (int size = 1024; size <= maxSize; size <<= 2) {
+		std::vector<int> keys(size), probes(lookups);
+		for (int i = 0; i < size; ++i)
+			keys[i] = (int)(rng() >> 1);
+		for (int i = 0; i < lookups; ++i)
+			probes[i] = keys[rng() % size];
+		Rates treap = run<TreeMap<int, int> >(keys, probes);
+		Rates btree = run<BTreeMap<int, int> >(keys, probes);
+		std::printf("%10d %12.2f %12.2f %12.2f %12.2f\n", size,
+				treap.get / 1e6, btree.get / 1e6, treap.scan / 1e6, btree.scan / 1e6);
+	}
+	std::printf("checksum: %lld\n", checksum);
+	return 0;
+}
@@ -0,0 +1,70 @@
+/** @file
+ * Throughput of ConcurrentHashMap as the thread count grows.
+ *
+ * Build from the repository root:
+ *     g++ -std=c++11 -O2 -pthread -I. benchmark/ConcurrentHashMapBenchmark.cpp -o chm_bench
+ * Usage: chm_bench [maxThreads] [opsPerThread] [readPercent]
+ *
+ * Every thread runs a random mix of get, put and remove over a shared key
+ * range, so puts keep replacing nodes and the retire lists stay busy. The
+ * thread count doubles from 1 to maxThreads (default 64).
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../ConcurrentHashMap.h"
+
+static const int KEY_RANGE = 1 << 20;
+
+static double run(int threads, int ops, int readPercent) {
+	ConcurrentHashMap<int, int> map;
+	for (int k = 0; k < KEY_RANGE; k += 2)
+		map.put(k, k);
+	std::vector<std::thread> workers;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int t = 0; t < threads; ++t)
+		workers.push_back(std::thread([&map, t, ops, readPercent]() {
+			std::mt19937 rng(t * 7919 + 1);
+			int value;
+			for (int i = 0; i < ops; ++i) {
+				int key = (int)(rng() % KEY_RANGE), dice = (int)(rng() % 100);
+				if (dice < readPercent)
+					map.tryGet(key, value);
+				else if (dice & 1)
+					map.put(key, i);
+				else if (map.containsKey(key)) {
+					try {
+						map.remove(key);
+					}
+					catch (ElementNotExist &) { // another thread removed it first
+					}
+				}
+			}
+		}));
+	for (size_t t = 0; t < workers.size(); ++t)
+		workers[t].join();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return (double)threads * ops / seconds;
+}
+
+int main(int argc, char **argv) {
+	int maxThreads = argc > 1 ? std::atoi(argv[1]) : 64;
+	int ops = argc > 2 ? std::atoi(argv[2]) : 1000000;
+	int readPercent = argc > 3 ? std::atoi(argv[3]) : 90;
+	std::printf("hardware threads: %u, ops per thread: %d, reads: %d%%\n",
+			std::thread::hardware_concurrency(), ops, readPercent);
+	std::printf("%8s %14s %9s\n", "threads", "Mops/s", "speedup");
+	double base = 0;
+	for (int threads = 1; threads <= maxThreads; threads <<= 1) {
+		double rate = run(threads, ops, readPercent);
+		if (threads == 1)
+			base = rate;
+		std::printf("%8d %14.2f %9.2f\n", threads, rate / 1e6, rate / base);
+	}
+	return 0;
+}
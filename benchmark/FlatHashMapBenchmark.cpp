@@ -0,0 +1,59 @@
+/** @file
+ * Lookup throughput of FlatHashMap against the chained HashMap.
+ *
+ * Build from the repository root:
+ *     g++ -std=c++11 -O2 -I. benchmark/FlatHashMapBenchmark.cpp -o flat_bench
+ * Usage: flat_bench [maxSize] [lookups] [hitPercent]
+ *
+ * Both maps are filled with the same random int keys, then looked up with
+ * the same random keys, hitPercent of which (default 90) are present; each
+ * probe is a containsKey, followed by a get if it hits. The size grows by a
+ * factor of four from 1024 to maxSize (default 2^22), so the tables go from
+ * cache-resident to well beyond the last-level cache.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "../FlatHashMap.h"
+#include "../HashMap.h"
+
+static long long checksum; // printed, so that the lookups cannot be optimized away
+
+template <class Map>
+static double run(const std::vector<int> &keys, const std::vector<int> &probes) {
+	Map map;
+	for (size_t i = 0; i < keys.size(); ++i)
+		map.put(keys[i], (int)i);
+	long long sum = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < probes.size(); ++i)
+		if (map.containsKey(probes[i]))
+			sum += map.get(probes[i]);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	checksum += sum;
+	return probes.size() / seconds;
+}
+
+int main(int argc, char **argv) {
+	int maxSize = argc > 1 ? std::atoi(argv[1]) : 1 << 22;
+	int lookups = argc > 2 ? std::atoi(argv[2]) : 10000000;
+	int hitPercent = argc > 3 ? std::atoi(argv[3]) : 90;
+	std::printf("lookups: %d, hits: %d%%\n", lookups, hitPercent);
+	std::printf("%10s %14s %14s %9s\n", "size", "HashMap Mops/s", "Flat Mops/s", "speedup");
+	std::mt19937 rng(12345);
+	for (int size = 1024; size <= maxSize; size <<= 2) {
+		std::vector<int> keys(size), probes(lookups);
+		for (int i = 0; i < size; ++i)
+			keys[i] = (int)(rng() >> 1) | 1; // odd keys are present, even keys are misses
+		for (int i = 0; i < lookups; ++i)
+			probes[i] = (int)(rng() % 100) < hitPercent ? keys[rng() % size] : (int)(rng() >> 1) & ~1;
+		double chained = run<HashMap<int, int> >(keys, probes);
+		double flat = run<FlatHashMap<int, int> >(keys, probes);
+		std::printf("%10d %14.2f %14.2f %9.2f\n", size, chained / 1e6, flat / 1e6, flat / chained);
+	}
+	std::printf("checksum: %lld\n", checksum);
+	return 0;
+}
@@ -0,0 +1,74 @@
+/** @file
+ * Insert and erase throughput of TreeMap, with std::map as a reference.
+ *
+ * Build from the repository root:
+ *     g++ -std=c++11 -O2 -I. benchmark/TreeMapInsertBenchmark.cpp -o treemap_bench
+ * Usage: treemap_bench [inserts]
+ *
+ * Puts inserts (default 10^7) random int keys into an empty map, erases
+ * every key put in another random order, and times each phase on its own.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <vector>
+#include "../TreeMap.h"
+
+struct Rates {
+	double insert, erase;
+};
+
+static double since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static Rates runTreeMap(const std::vector<int> &keys, const std::vector<int> &order) {
+	TreeMap<int, int> map;
+	Rates rates;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < keys.size(); ++i)
+		map.put(keys[i], (int)i);
+	rates.insert = keys.size() / since(start);
+	start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < order.size(); ++i)
+		map.remove(order[i]);
+	rates.erase = order.size() / since(start);
+	return rates;
+}
+
+static Rates runStdMap(const std::vector<int> &keys, const std::vector<int> &order) {
+	std::map<int, int> map;
+	Rates rates;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < keys.size(); ++i)
+		map[keys[i]] = (int)i;
+	rates.insert = keys.size() / since(start);
+	start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < order.size(); ++i)
+		map.erase(order[i]);
+	rates.erase = order.size() / since(start);
+	return rates;
+}
+
+int main(int argc, char **argv) {
+	int inserts = argc > 1 ? std::atoi(argv[1]) : 10000000;
+	std::mt19937 rng(12345);
+	std::vector<int> keys(inserts);
+	for (int i = 0; i < inserts; ++i)
+		keys[i] = (int)(rng() >> 1);
+	std::vector<int> order(keys); // every distinct key once, shuffled
+	std::sort(order.begin(), order.end());
+	order.erase(std::unique(order.begin(), order.end()), order.end());
+	std::shuffle(order.begin(), order.end(), rng);
+	std::printf("inserts: %d, distinct keys: %d\n", inserts, (int)order.size());
+	std::printf("%10s %16s %16s\n", "map", "insert Mops/s", "erase Mops/s");
+	Rates treap = runTreeMap(keys, order);
+	std::printf("%10s %16.2f %16.2f\n", "TreeMap", treap.insert / 1e6, treap.erase / 1e6);
+	Rates reference = runStdMap(keys, order);
+	std::printf("%10s %16.2f %16.2f\n", "std::map", reference.insert / 1e6, reference.erase / 1e6);
+	return 0;
+}